@@ -0,0 +1,224 @@
+//
+//  AnimationBaker.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "AnimationBaker.h"
+#include "Threads.h"
+#include "PoseTimeline.h"
+#include "Skinning.h"
+#include "Mesh.h"
+
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+const size_t AnimationBaker::MAX_BATCH_BYTES;
+
+VertexCacheWriter::VertexCacheWriter (const string & filename, unsigned int nbVertices, unsigned int nbFrames,
+                                      float startFrame, float sampleRate)
+    : filename (filename), file (NULL), hasPending (false), closing (false), failed (false) {
+    file = fopen (filename.c_str (), "wb");
+    if (file == NULL)
+        throw Mesh::Exception ("Failing opening the file " + filename + ".");
+    //en-tête de 32 octets (les champs sont en little endian, comme la machine)
+    char signature[12] = "POINTCACHE2";
+    int32_t version = 1, points = nbVertices, samples = nbFrames;
+    bool ok = fwrite (signature, 1, 12, file) == 12
+        && fwrite (&version, 4, 1, file) == 1 && fwrite (&points, 4, 1, file) == 1
+        && fwrite (&startFrame, 4, 1, file) == 1 && fwrite (&sampleRate, 4, 1, file) == 1
+        && fwrite (&samples, 4, 1, file) == 1;
+    if (!ok) {
+        fclose (file);
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+    }
+    writer = thread (&VertexCacheWriter::run, this);
+}
+
+VertexCacheWriter::~VertexCacheWriter () {
+    try {
+        close ();
+    } catch (const Mesh::Exception &) {
+    }
+}
+
+void VertexCacheWriter::run () {
+    unique_lock<std::mutex> lock (mutex);
+    while (true) {
+        condition.wait (lock, [this] { return hasPending || closing; });
+        if (!hasPending)
+            return;
+        //le tampon n'est plus touché par l'appelant tant que hasPending est vrai
+        lock.unlock ();
+        bool ok = pending.empty () || fwrite (pending.data (), sizeof (float), pending.size (), file) == pending.size ();
+        lock.lock ();
+        failed = failed || !ok;
+        hasPending = false;
+        condition.notify_all ();
+    }
+}
+
+void VertexCacheWriter::write (vector<float> & frames) {
+    unique_lock<std::mutex> lock (mutex);
+    condition.wait (lock, [this] { return !hasPending; });
+    pending.swap (frames);
+    hasPending = true;
+    condition.notify_all ();
+}
+
+void VertexCacheWriter::close () {
+    if (file == NULL)
+        return;
+    {
+        lock_guard<std::mutex> lock (mutex);
+        closing = true;
+    }
+    condition.notify_all ();
+    writer.join ();
+    bool ok = !failed;
+    ok = (fclose (file) == 0) && ok;
+    file = NULL;
+    if (!ok)
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+}
+
+//threads de calcul des images, créés une fois pour toute l'animation et nourris lot après lot :
+//run() publie un lot, le thread appelant en calcule sa part et attend que toutes les images soient faites
+class FramePool {
+public:
+    FramePool (const Skinning & skinning, const PoseTimeline & timeline, unsigned int nbWorkers)
+        : skinning (skinning), timeline (timeline), generation (0), first (0), count (0), start (0), fps (1),
+          frameSize (0), frames (NULL), next (0), done (0), active (0), stopping (false) {
+        for (unsigned int i = 0; i < nbWorkers; i++)
+            workers.push_back (thread (&FramePool::work, this));
+    }
+    ~FramePool () {
+        {
+            lock_guard<std::mutex> lock (mutex);
+            stopping = true;
+        }
+        started.notify_all ();
+        for (size_t i = 0; i < workers.size (); i++)
+            workers[i].join ();
+    }
+
+    //images first .. first + count - 1, de taille frameSize, écrites dans batch
+    void run (unsigned int first, unsigned int count, float start, float fps, size_t frameSize, float * batch) {
+        {
+            //un thread réveillé en retard peut encore tirer dans le lot précédent : on attend qu'il en soit sorti
+            unique_lock<std::mutex> lock (mutex);
+            finished.wait (lock, [this] () { return active == 0; });
+            this->first = first;
+            this->count = count;
+            this->start = start;
+            this->fps = fps;
+            this->frameSize = frameSize;
+            frames = batch;
+            next = 0;
+            done = 0;
+            generation++;
+        }
+        started.notify_all ();
+        vector<float> transforms (Skinning::TRANSFORM_SIZE * skinning.getNbBones ());
+        unsigned int n = compute (transforms);
+        unique_lock<std::mutex> lock (mutex);
+        done += n;
+        finished.wait (lock, [this] () { return done == this->count && active == 0; });
+    }
+
+private:
+    FramePool (const FramePool &);
+    FramePool & operator= (const FramePool &);
+
+    //chaque thread prend la prochaine image du lot, avec ses propres transformations
+    unsigned int compute (vector<float> & transforms) {
+        unsigned int n = 0;
+        for (unsigned int f = next++; f < count; f = next++, n++) {
+            timeline.evaluate (start + (first + f) / fps, transforms.data ());
+            skinning.evaluate (transforms.data (), frames + f * frameSize);
+        }
+        return n;
+    }
+
+    void work () {
+        vector<float> transforms (Skinning::TRANSFORM_SIZE * skinning.getNbBones ());
+        unsigned int seen = 0;
+        while (true) {
+            {
+                unique_lock<std::mutex> lock (mutex);
+                started.wait (lock, [&] () { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                active++;
+            }
+            unsigned int n = compute (transforms);
+            {
+                lock_guard<std::mutex> lock (mutex);
+                done += n;
+                active--;
+            }
+            finished.notify_one ();
+        }
+    }
+
+    const Skinning & skinning;
+    const PoseTimeline & timeline;
+    vector<thread> workers;
+    std::mutex mutex;
+    condition_variable started;     // nouveau lot ou arrêt
+    condition_variable finished;    // images du lot terminées
+    unsigned int generation;        // numéro du lot publié
+    unsigned int first, count;
+    float start, fps;
+    size_t frameSize;
+    float * frames;
+    atomic<unsigned int> next;
+    unsigned int done;              // images du lot terminées
+    unsigned int active;            // threads en train de tirer dans le lot
+    bool stopping;
+};
+
+AnimationBaker::AnimationBaker () : nbThreads (defaultNbThreads ()) {}
+
+void AnimationBaker::bake (const Skinning & skinning, const PoseTimeline & timeline, const string & filename,
+                           float fps, unsigned int nbFrames, float start, Progress * progress) {
+    if (!skinning.isBound () || timeline.getNbBones () != skinning.getNbBones ())
+        throw Mesh::Exception ("The animation does not match the skeleton.");
+    if (fps <= 0)
+        throw Mesh::Exception ("Invalid frame rate.");
+
+    const size_t frameSize = 3 * size_t (skinning.getNbVertices ());
+    unsigned int batchSize = max<size_t> (1, min<size_t> (4 * nbThreads, MAX_BATCH_BYTES / (sizeof (float) * max<size_t> (frameSize, 1))));
+    VertexCacheWriter writer (filename, skinning.getNbVertices (), nbFrames, start * fps, 1.f);
+
+    try {
+        FramePool pool (skinning, timeline, min (max (nbThreads, 1u), batchSize) - 1);
+        vector<float> batch;
+        for (unsigned int first = 0; first < nbFrames; first += batchSize) {
+            if (progress)
+                progress->set ("Animation", float (first) / nbFrames);
+            unsigned int count = min (batchSize, nbFrames - first);
+            batch.resize (count * frameSize);
+
+            pool.run (first, count, start, fps, frameSize, batch.data ());
+
+            //batch récupère le tampon du lot précédent (déjà écrit) pour le lot suivant
+            writer.write (batch);
+        }
+        writer.close ();
+    } catch (const Progress::Cancelled &) {
+        try {
+            writer.close ();
+        } catch (const Mesh::Exception &) {
+        }
+        remove (filename.c_str ());
+        throw;
+    }
+}
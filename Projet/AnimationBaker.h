@@ -0,0 +1,82 @@
+//
+//  AnimationBaker.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__AnimationBaker__
+#define __Projet__AnimationBaker__
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+
+#include "Progress.h"
+
+class Skinning;
+class PoseTimeline;
+
+class VertexCacheWriter {
+    //fichier de positions par image au format Point Cache 2 (.pc2, relu par Blender, 3ds Max...) :
+    //en-tête "POINTCACHE2", version, nombre de vertices, première image, pas entre images, nombre d'images,
+    //puis x y z en float (little endian) pour chaque vertex de chaque image.
+    //écriture en double tampon : write() confie un lot d'images au thread d'écriture et rend le tampon
+    //du lot précédent, déjà écrit, que l'appelant remplit pendant l'écriture.
+public:
+    //lève Mesh::Exception si le fichier ne peut pas être créé
+    VertexCacheWriter (const std::string & filename, unsigned int nbVertices, unsigned int nbFrames,
+                       float startFrame = 0.f, float sampleRate = 1.f);
+    virtual ~VertexCacheWriter ();
+
+    //frames : un nombre entier d'images (3 floats par vertex) ; attend la fin de l'écriture précédente
+    void write (std::vector<float> & frames);
+    //attend la fin des écritures et ferme le fichier ; lève Mesh::Exception si une écriture a échoué
+    void close ();
+
+private:
+    VertexCacheWriter (const VertexCacheWriter &);
+    VertexCacheWriter & operator= (const VertexCacheWriter &);
+
+    void run ();
+
+    std::string filename;
+    FILE * file;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<float> pending;     // lot en cours d'écriture
+    bool hasPending;
+    bool closing;
+    bool failed;
+};
+
+class AnimationBaker {
+    //calcul hors ligne des poses d'une animation (cf PoseTimeline) et écriture dans un fichier .pc2.
+    //les images sont calculées par lots : chaque thread (créés une fois par animation) prend la prochaine
+    //image du lot (Skinning::evaluate), puis le lot part au thread d'écriture pendant que le suivant
+    //est calculé (cf VertexCacheWriter).
+public:
+    //taille maximale d'un lot d'images en mémoire (deux lots existent à la fois)
+    static const size_t MAX_BATCH_BYTES = 64 * 1024 * 1024;
+
+    AnimationBaker ();
+
+    inline void setNbThreads (unsigned int n) { nbThreads = n; }
+    inline unsigned int getNbThreads () const { return nbThreads; }
+
+    //nbFrames images, de start à start + (nbFrames - 1) / fps secondes ; skinning doit avoir une pose de repos
+    //(cf Mesh::bindPose) avec autant de bones que timeline. Lève Mesh::Exception (fichier, squelette) ;
+    //progress (optionnel) : avancement par lot, l'annulation efface le fichier.
+    void bake (const Skinning & skinning, const PoseTimeline & timeline, const std::string & filename,
+               float fps, unsigned int nbFrames, float start = 0.f, Progress * progress = NULL);
+
+private:
+    unsigned int nbThreads;
+};
+
+#endif /* defined(__Projet__AnimationBaker__) */
@@ -7,6 +7,9 @@
 // *********************************************************
 
 #include "GLViewer.h"
+#include "MeshBinary.h"
+#include "MeshExporter.h"
+#include "Window.h"
 #include "GLUT/glut.h"
 #include "QtGui/QMenu"
 
@@ -17,7 +20,8 @@
 #include <cassert>
 #include <string>
 #include <QFileDialog>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QTimer>
 
 #include <opencv.hpp>
 
@@ -34,6 +38,13 @@ GLViewer::GLViewer () : QGLViewer () {
     model_name = "models/bone.obj";
     renderingMode = Smooth;
     selectionMode = Standard;
+    loadingFramed = true;
+    sceneSaved = false;
+    savedWeightsPending = false;
+    loadingTimer = new QTimer(this);
+    connect(loadingTimer, SIGNAL(timeout()), this, SLOT(checkLoading()));
+    weightTimer = new QTimer(this);
+    connect(weightTimer, SIGNAL(timeout()), this, SLOT(checkWeights()));
     initMesh();
     updateGL();
     
@@ -42,29 +53,169 @@ GLViewer::GLViewer () : QGLViewer () {
 void GLViewer::initMesh() {
     
     Mesh ramMesh;
-    ramMesh.loadOBJ(model_name);
+    //le .meshbin à côté du modèle est utilisé s'il est plus récent (pas de parsing ni de calcul des normales)
+    MeshBinary::loadCached(ramMesh, model_name);
     object  = Object(ramMesh);
     
 }
 
 void GLViewer::loadMesh(){
     
-    QString name = QFileDialog::getOpenFileName(this,"Ouvrir un mesh");
-    Mesh mesh;
+    QString name = QFileDialog::getOpenFileName(this,"Ouvrir un mesh", QString(), "Mesh (*.off *.obj *.ply *.meshbin *.qmesh)");
+    if (name.isEmpty()){
+        return;
+    }
     //hypothèse : le mesh se trouve dans le répertoire /models.
     //normalement pas besoin de ne récupérer que la dernière partie (mais j'avais un problème au niveau du split qui ne se faisait pas bien en raison d'accent dans mon path).
     cout << qPrintable(name) << endl;
     QStringList listName = name.split("/");
     string finalName = "models/" + listName[listName.size()-1].toStdString();
-    model_name = finalName;
-    mesh.loadOBJ(finalName);
-    object = Object(mesh);
-    //dans le cas où le bouton areainfluence est enclenché, il faut tout de suite calculer les poids !
-    if (influenceArea){
-        object.getMesh().initWeights();
+    //choix du lecteur selon l'extension : un .meshbin est lu tel quel, les autres formats passent par le cache
+    string extension = QFileInfo(name).suffix().toLower().toStdString();
+    if (extension != "meshbin" && extension != "off" && extension != "obj" && extension != "ply" && extension != "qmesh"){
+        Window::showStatusMessage(QString("Format de mesh inconnu : ") + finalName.c_str());
+        return;
+    }
+    
+    //lecture (et calcul des poids si la zone d'influence est affichée) dans un autre thread :
+    //la scène actuelle reste utilisable, checkLoading installe le nouvel objet quand il est prêt
+    loader.start(finalName, influenceArea);
+    loadingFramed = false;
+    loadingTimer->start(100);
+    checkLoading();
+}
+
+void GLViewer::checkLoading(){
+    
+    switch (loader.getState()){
+        case MeshLoader::Running: {
+            //aperçu d'un gros mesh : affiché (et cadré) avant la fin de la lecture
+            Object preview;
+            if (loader.takePreview(preview)){
+                //la scène d'avant est gardée de côté (rendue si le chargement est annulé ou échoue) ;
+                //ses poids en cours de calcul ne peuvent plus être installés pendant l'aperçu
+                if (!sceneSaved){
+                    savedWeightsPending = weightWorker.getState() == WeightWorker::Running;
+                    weightWorker.cancel();
+                    weightTimer->stop();
+                    savedObject.swap(object);
+                    sceneSaved = true;
+                }
+                //l'aperçu précédent (sans bones) part avec preview
+                object.swap(preview);
+                bone_selected = false;
+                if (!loadingFramed){
+                    frameScene();
+                    loadingFramed = true;
+                }
+                updateGL();
+            }
+            string step;
+            float fraction;
+            loader.getProgress(step, fraction);
+            Window::showStatusMessage(QString("%1... %2% (annuler : Cancel loading)").arg(step.c_str()).arg(int(100 * fraction)));
+            return;
+        }
+        case MeshLoader::Finished: {
+            model_name = loader.getFilename();
+            //les poids en cours de calcul sont ceux de l'ancien mesh
+            weightWorker.cancel();
+            //l'ancienne scène revient le temps de l'échange, qui libère ses bones (l'aperçu n'en a pas)
+            if (sceneSaved){
+                object.swap(savedObject);
+                savedObject = Object();
+                sceneSaved = false;
+            }
+            //échange en une fois, entre deux affichages ; le nouveau mesh garde le mode choisi dans le panneau
+            Skinning::Mode skinningMode = object.getMesh().getSkinningMode();
+            loader.takeObject(object);
+            object.getMesh().setSkinningMode(skinningMode);
+            bone_selected = false;
+            if (!loadingFramed){
+                frameScene();
+            }
+            Window::showStatusMessage(QString("Mesh chargé : ") + model_name.c_str());
+            updateGL();
+            break;
+        }
+        case MeshLoader::Failed:
+            Window::showStatusMessage(QString("Erreur de chargement : ") + loader.getError().c_str());
+            loader.cancel();
+            restoreScene();
+            break;
+        case MeshLoader::Cancelled:
+        case MeshLoader::Idle:
+            break;
+    }
+    loadingTimer->stop();
+}
+
+void GLViewer::cancelLoading(){
+    
+    if (loader.getState() == MeshLoader::Running){
+        loader.cancel();
+        loadingTimer->stop();
+        restoreScene();
+        Window::showStatusMessage("Chargement annulé");
+    }
+}
+
+void GLViewer::restoreScene(){
+    
+    if (!sceneSaved){
+        return;
+    }
+    object.swap(savedObject);
+    savedObject = Object();
+    sceneSaved = false;
+    bone_selected = false;
+    frameScene();
+    //les poids abandonnés à l'affichage de l'aperçu sont relancés
+    if (savedWeightsPending){
+        updateWeights();
     }
     updateGL();
+}
+
+void GLViewer::updateWeights(){
+    
+    Mesh & mesh = object.getMesh();
+    //en attendant le résultat, on garde les poids précédents s'ils correspondent encore aux bones,
+    //sinon (bone ajouté ou supprimé) on affiche un aperçu calculé sur les distances
+    if (mesh.getInfluences().getNbBones() != mesh.getBones().size() || mesh.getInfluences().getNbVertices() != mesh.getVertices().size()){
+        mesh.previewWeights();
+    }
+    //un calcul lancé pour une modification précédente est annulé
+    weightWorker.start(mesh);
+    weightTimer->start(50);
+}
+
+void GLViewer::checkWeights(){
     
+    switch (weightWorker.getState()){
+        case WeightWorker::Running: {
+            string step;
+            float fraction;
+            weightWorker.getProgress(step, fraction);
+            Window::showStatusMessage(QString("%1...").arg(step.c_str()));
+            return;
+        }
+        case WeightWorker::Finished:
+            //échange des tables entre deux affichages
+            if (weightWorker.takeResult(object.getMesh())){
+                Window::showStatusMessage("Poids à jour");
+                updateGL();
+            }else{
+                //poids d'un squelette précédent : on relance le calcul pour le squelette actuel
+                updateWeights();
+                return;
+            }
+            break;
+        case WeightWorker::Cancelled:
+        case WeightWorker::Idle:
+            break;
+    }
+    weightTimer->stop();
 }
 
 void GLViewer::supprBone(){
@@ -82,8 +233,12 @@ void GLViewer::supprBone(){
         bone_selected = false;
         
         //dans le cas ou le bouton areainfluence est enclenché, il faut tout de suite calculer les poids !
+        //(en arrière-plan : l'aperçu est affiché en attendant). Sinon un calcul en cours est celui de l'ancien squelette
         if (influenceArea){
-            object.getMesh().initWeights();
+            updateWeights();
+        }else{
+            weightWorker.cancel();
+            weightTimer->stop();
         }
         updateGL();
     }
@@ -93,67 +248,29 @@ void GLViewer::supprBone(){
 void GLViewer::exportMesh(){
     //on enregistre le mesh ainsi que les bones dans un .obj (les bones sont des objets qui commencent par S)
     //attention, lors de l'enregistrement, on enregistre d'abord les vertices du mesh et ensuite les vertices du bones (dont les indices sont ceux consécutifs aux vertices du mesh).
+    //on peut aussi enregistrer en binaire (.meshbin), avec la même convention pour les bones.
     
     //demander le nom sous lequel est enregistré le mesh
-    QString name = QFileDialog::getSaveFileName(this, "Enregistrer un fichier en .obj", QString(), "Mesh (*.obj)");
+    QString filter;
+    QString name = QFileDialog::getSaveFileName(this, "Enregistrer un fichier en .obj", QString(), "Mesh (*.obj);;Binary mesh (*.meshbin);;PLY (*.ply);;Compressed mesh (*.qmesh)", &filter);
+    if (name.isEmpty()){
+        return;
+    }
     QFileInfo f( name);
     if (f.suffix().isEmpty()){
-        name +=".obj";
-    }
-    
-    QFile file(name);
-    
-    if (!file.open(QIODevice::WriteOnly)){
-        cout << "c'est une erreur de fichier" << endl;
-    }else{
-        
-        QTextStream stream(&file);
-        //on enregistre d'abord l'objet
-        stream << "o face" << endl;
-        
-        //on enregistre tous les vertices
-        std::vector<Vertex> vertices = object.getMesh().getVertices();
-        
-        for (unsigned int i = 0; i< vertices.size(); i++){
-            stream << "v " << vertices[i].getPos()[0] << " " << vertices[i].getPos()[1] << " " << vertices[i].getPos()[2] << endl;
-        }
-        
-        //on enregistre toutes les faces (ici triangles)
-        //attention, si on veut rajouter la texture, il faut rajouter des / avec le numéro de la texture
-        //il faudrait rajouter aussi une autre boucle pour écrire les textures avec vt au début
-        std::vector<Triangle> triangles = object.getMesh().getTriangles();
-        
-        for (unsigned int i = 0; i< triangles.size() ; i++){
-            stream << "f " << triangles[i].getVertex(0)+1 << " " << triangles[i].getVertex(1)+1 << " " << triangles[i].getVertex(2)+1 << endl;
-        }
-        
-        //on enregistre ensuite les bones
-        stream << "s bone" << endl;
-        
-        //on enregistre les vertices des bones
-        std::vector<Vertex> bones_vertices = object.getMesh().getBonesVertices();
-        for (unsigned int i =0; i< bones_vertices.size(); i++){
-            stream << "v " << bones_vertices[i].getPos()[0] << " " << bones_vertices[i].getPos()[1] << " " << bones_vertices[i].getPos()[2] << endl;
-        }
-        
-        //on enregistre les lignes ou les poignées des bones
-        //les index des vertices des bones commencent à partir de la fin des index des vertices du mesh !
-        std::vector< Armature* > armatures = object.getMesh().getBones();
-        
-        for (unsigned int i =0; i< armatures.size(); i++){
-            
-            if (armatures[i]->getType() =="bone"){
-                // alors il s'agit d'un bone et on trace une ligne -> "l"
-                stream << "l " << armatures[i]->getVertex(0) + vertices.size()+1 << " " << armatures[i]->getVertex(1) + vertices.size()+1 << endl;
-            }
-            
-            if (armatures[i]->getType() == "handle"){
-                //alors il s'agit d'un handle, donc d'un unique point
-                stream << "lv " << armatures[i]->getVertex(0) + vertices.size()+1 << endl;
-            }
+        if (filter.contains("meshbin")){
+            name += ".meshbin";
+        }else if (filter.contains("ply")){
+            name += ".ply";
+        }else if (filter.contains("qmesh")){
+            name += ".qmesh";
+        }else{
+            name += ".obj";
         }
-        
     }
+    
+    //l'écriture se fait dans un autre thread, sur une copie du mesh : l'interface n'est pas bloquée
+    MeshExporter::exportInBackground(object.getMesh(), name.toStdString());
         
 }
 
@@ -173,7 +290,7 @@ void GLViewer::setInfluenceArea(bool b){
     influenceArea = b;
     //je calcule le poids seulement si je veux afficher les zone d'influence !
     if (b){
-        object.getMesh().initWeights();
+        updateWeights();
     }
     updateGL();
 }
@@ -184,6 +301,16 @@ void GLViewer::setBoneVisualisation(bool b){
     updateGL();
 }
 
+void GLViewer::setSkinningMode(int m){
+    Mesh & mesh = object.getMesh();
+    mesh.setSkinningMode(static_cast<Skinning::Mode>(m));
+    //la pose en cours est recalculée avec l'autre mélange
+    if (mesh.getSkinning().isBound()){
+        mesh.deform();
+    }
+    updateGL();
+}
+
 void GLViewer::setRenderingMode (RenderingMode m) {
     renderingMode = m;
     updateGL ();
@@ -199,7 +326,12 @@ void GLViewer::setSelectionMode(SelectionMode m){
 void GLViewer::reinit(){
     
     bone_selected = false;
+    //un chargement en cours remplacerait la scène réinitialisée
+    cancelLoading();
+    weightWorker.cancel();
+    Skinning::Mode skinningMode = object.getMesh().getSkinningMode();
     initMesh();
+    object.getMesh().setSkinningMode(skinningMode);
     updateGL();
 }
 
@@ -280,6 +412,18 @@ void GLViewer::mousePressEvent (QMouseEvent * event) {
                 
                 cout << "BONE !!! " << endl;
                 bone_selected = true;
+                //la pose de repos se prend avec les poids disponibles : un calcul encore en cours continue,
+                //ses poids remplaceront ceux-ci à leur arrivée (cf checkWeights, Mesh::swapInfluences)
+                Mesh & mesh = object.getMesh();
+                if (weightWorker.getState() == WeightWorker::Finished){
+                    checkWeights();
+                }
+                if (mesh.getInfluences().getNbBones() != mesh.getBones().size() || mesh.getInfluences().getNbVertices() != mesh.getVertices().size()){
+                    //pas encore de poids pour ce squelette (un calcul en cours serait celui d'un autre squelette) :
+                    //aperçu tout de suite, résolution en arrière-plan
+                    updateWeights();
+                }
+                mesh.bindPose();
                 mouse_x = mouse_interm_x = event->pos().x();
                 mouse_y = mouse_interm_y = event->pos().y();
                 updateGL();
@@ -342,7 +486,16 @@ void GLViewer::mousePressEvent (QMouseEvent * event) {
                 
                 //ajout du handle dans le mesh
                 Vertex vert = Vertex(Vec3Df(vec[0], vec[1], vec[2]) );
-                object.getMesh().addHandle(vert, influenceArea);
+                object.getMesh().addHandle(vert);
+                //si la case influenceArea est cochée, l'utilisateur peut directement recliquer sur le nouveau handle :
+                //on recalcule les poids. Sinon pas besoin, le calcul sera fait quand elle sera cochée (ou au clic sur
+                //un bone) ; un calcul en cours est celui de l'ancien squelette
+                if (influenceArea){
+                    updateWeights();
+                }else{
+                    weightWorker.cancel();
+                    weightTimer->stop();
+                }
                 updateGL();
             }else{
                 cout << " impossible de rajouter un handle sur le mesh " << endl;
@@ -395,6 +548,8 @@ void GLViewer::mouseMoveEvent(QMouseEvent *event){
             //on déplace uniquement le sommet du bone mais pas sa boundingBox, donc il est toujours repéré au même endroit par le rayon origin et dir
             //on changera sa boundingbox une seule fois dans le mouserelease, alors dir et origin ne correspondront plus à ce bone mais c'est pas grave car on est obligé de recliquer sur mousepress pour sélectionner un bone et alors dir et origin seront mis à jour !
             object.getMesh().modifyBone(idx_bone, x*dx, y*dy);
+            //retour immédiat : seuls les vertices influencés par les bones déplacés sont recalculés (cf Skinning::apply)
+            object.getMesh().deform();
             updateGL();
             
         }
@@ -472,7 +627,8 @@ void GLViewer::mouseReleaseEvent(QMouseEvent *event){
                 
                 //le bone est déjà déplace avec le mousemove mais il faut que j'actualise la boundingbox
                 object.getMesh().modifyBone(idx_bone, Vec3Df(0,0,0), Vec3Df(0,0,0), true);
-                object.getMesh().modifyMesh(idx_bone, x*dx, y*dy);
+                //le mesh suit déjà le bone (mousemove) : rien à recalculer si la souris n'a pas bougé depuis
+                object.getMesh().deform();
                 updateGL();
             }
         }
@@ -489,6 +645,12 @@ void GLViewer::mouseReleaseEvent(QMouseEvent *event){
                 Vec3Df intersectionPoint;
                 object.getBoneSelected(ray, idx_bone, intersectionPoint);
                 object.getMesh().modifyBone(idx_bone, Vec3Df(0,0,0), Vec3Df(0,0,0), true);
+                //le squelette édité définit une nouvelle pose de repos
+                object.getMesh().editSkeleton();
+                //les poids suivent le bone déplacé, case cochée ou non : la table actuelle a encore le bon nombre de
+                //vertices et de bones, bindPose la prendrait sans recalcul (en arrière-plan, les anciens restent
+                //affichés en attendant)
+                updateWeights();
                 updateGL();
             }
         }
@@ -513,13 +675,17 @@ void GLViewer::init() {
 
     glLoadIdentity ();
 
+    frameScene();
+    
+}
+
+void GLViewer::frameScene() {
     const BoundingBox & box = object.getBoundingBox();
     Vec3Df c = box.getCenter();
     float r = box.getRadius() + 1;
     setSceneCenter (qglviewer::Vec (c[0], c[1], c[2]));
     setSceneRadius (r);
     showEntireScene ();
-    
 }
 
 void GLViewer::draw () {
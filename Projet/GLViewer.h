@@ -16,6 +16,10 @@
 #include <string>
 
 #include "Object.h"
+#include "MeshLoader.h"
+#include "WeightWorker.h"
+
+class QTimer;
 
 class GLViewer : public QGLViewer  {
     Q_OBJECT
@@ -48,20 +52,30 @@ public slots :
     void reinit();
     void exportMesh();
     void loadMesh();
+    void checkLoading();
+    void cancelLoading();
+    void checkWeights();
     void supprBone();
     void setInfluenceArea(bool);
     void setBoneVisualisation(bool);
+    //Skinning::Mode du mesh affiché (LBS ou quaternions duaux)
+    void setSkinningMode(int m);
     void initTexture();
     GLubyte* readPpm();
     
 protected :
     void init();
+    void frameScene();
     void initMesh();
     void draw ();
     QString helpString() const;
     void selection(int x, int y);
     void list_hits(GLint hits, GLuint *names);
     bool computeBonesIntersected(QPoint pos, std::map< int, std::pair <int, Vec3Df> > & intersectionList );
+    //relance le calcul des poids en arrière-plan (cf WeightWorker)
+    void updateWeights();
+    //remet la scène mise de côté par le premier aperçu d'un chargement annulé ou échoué
+    void restoreScene();
 
     virtual void keyPressEvent (QKeyEvent * event);
     virtual void keyReleaseEvent (QKeyEvent * event);
@@ -81,6 +95,14 @@ private:
     Vec3Df origin, direction; //origin et direction de la caméra vers le point sélectionné
     float mouse_x, mouse_y, mouse_interm_x, mouse_interm_y;
     Object object;
+    MeshLoader loader; //chargement en cours dans un autre thread
+    QTimer * loadingTimer;
+    bool loadingFramed; //la scène a déjà été cadrée sur un aperçu du chargement en cours
+    Object savedObject; //scène d'avant le chargement quand un aperçu est affiché à sa place
+    bool sceneSaved;
+    bool savedWeightsPending; //son calcul des poids a été annulé par l'aperçu
+    WeightWorker weightWorker; //calcul des poids en cours dans un autre thread
+    QTimer * weightTimer;
 };
 
 #endif // GLVIEWER_H
@@ -22,7 +22,7 @@ static const uint qt_meta_data_GLViewer[] = {
        6,       // revision
        0,       // classname
        0,    0, // classinfo
-      11,   14, // methods
+      15,   14, // methods
        0,    0, // properties
        0,    0, // enums/sets
        0,    0, // constructors
@@ -39,8 +39,12 @@ static const uint qt_meta_data_GLViewer[] = {
      150,   30,   30,   30, 0x0a,
      163,   30,   30,   30, 0x0a,
      174,   30,   30,   30, 0x0a,
-     186,   30,   30,   30, 0x0a,
-     209,   30,   30,   30, 0x0a,
+     189,   30,   30,   30, 0x0a,
+     205,   30,   30,   30, 0x0a,
+     220,   30,   30,   30, 0x0a,
+     232,   30,   30,   30, 0x0a,
+     255,   30,   30,   30, 0x0a,
+     282,   63,   30,   30, 0x0a,
 
        0        // eod
 };
@@ -51,9 +55,12 @@ static const char qt_meta_stringdata_GLViewer[] = {
     "setRenderingMode(int)\0"
     "setSelectionMode(SelectionMode)\0"
     "setSelectionMode(int)\0reinit()\0"
-    "exportMesh()\0loadMesh()\0supprBone()\0"
+    "exportMesh()\0loadMesh()\0"
+    "checkLoading()\0cancelLoading()\0"
+    "checkWeights()\0supprBone()\0"
     "setInfluenceArea(bool)\0"
     "setBoneVisualisation(bool)\0"
+    "setSkinningMode(int)\0"
 };
 
 void GLViewer::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, void **_a)
@@ -70,9 +77,13 @@ void GLViewer::qt_static_metacall(QObject *_o, QMetaObject::Call _c, int _id, vo
         case 5: _t->reinit(); break;
         case 6: _t->exportMesh(); break;
         case 7: _t->loadMesh(); break;
-        case 8: _t->supprBone(); break;
-        case 9: _t->setInfluenceArea((*reinterpret_cast< bool(*)>(_a[1]))); break;
-        case 10: _t->setBoneVisualisation((*reinterpret_cast< bool(*)>(_a[1]))); break;
+        case 8: _t->checkLoading(); break;
+        case 9: _t->cancelLoading(); break;
+        case 10: _t->checkWeights(); break;
+        case 11: _t->supprBone(); break;
+        case 12: _t->setInfluenceArea((*reinterpret_cast< bool(*)>(_a[1]))); break;
+        case 13: _t->setBoneVisualisation((*reinterpret_cast< bool(*)>(_a[1]))); break;
+        case 14: _t->setSkinningMode((*reinterpret_cast< int(*)>(_a[1]))); break;
         default: ;
         }
     }
@@ -110,9 +121,9 @@ int GLViewer::qt_metacall(QMetaObject::Call _c, int _id, void **_a)
     if (_id < 0)
         return _id;
     if (_c == QMetaObject::InvokeMetaMethod) {
-        if (_id < 11)
+        if (_id < 15)
             qt_static_metacall(this, _c, _id, _a);
-        _id -= 11;
+        _id -= 15;
     }
     return _id;
 }
@@ -31,6 +31,7 @@ public:
     inline unsigned int getVertex (unsigned int i = 0) const { return v; }
     inline void setVertex (unsigned int i, unsigned int vertex) { v = vertex; }
     inline bool contains (unsigned int vertex) const { return (v == vertex) ; }
+    inline virtual Armature * clone () const { return new Handle (*this); }
     inline virtual std::string getType() { return "handle"; }
     
     void buildBox(Vertex v0);
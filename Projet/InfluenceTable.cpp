@@ -0,0 +1,129 @@
+//
+//  InfluenceTable.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 28/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "InfluenceTable.h"
+
+#include <cmath>
+
+using namespace std;
+
+const unsigned int InfluenceTable::K;
+const uint16_t InfluenceTable::NO_BONE;
+
+void InfluenceTable::clear () {
+    nbVertices = 0;
+    nbBones = 0;
+    bones.clear ();
+    weights.clear ();
+    weights16.clear ();
+    weights8.clear ();
+}
+
+void InfluenceTable::swap (InfluenceTable & table) {
+    std::swap (nbVertices, table.nbVertices);
+    std::swap (nbBones, table.nbBones);
+    std::swap (precision, table.precision);
+    bones.swap (table.bones);
+    weights.swap (table.weights);
+    weights16.swap (table.weights16);
+    weights8.swap (table.weights8);
+}
+
+size_t InfluenceTable::memorySize () const {
+    return bones.size () * sizeof (uint16_t) + weights.size () * sizeof (float)
+        + weights16.size () * sizeof (uint16_t) + weights8.size () * sizeof (uint8_t);
+}
+
+//les K poids d'un vertex, triés et normalisés, dans la précision de la table.
+//en quantifié, l'erreur d'arrondi est reportée sur le plus gros poids pour que la somme reste exacte.
+void InfluenceTable::store (unsigned int v, const uint16_t * vertexBones, const float * vertexWeights) {
+    float sum = 0;
+    for (unsigned int k = 0; k < K; k++)
+        sum += vertexWeights[k];
+    float normalized[K];
+    for (unsigned int k = 0; k < K; k++) {
+        bones[K*v + k] = vertexBones[k];
+        normalized[k] = (sum > 0) ? vertexWeights[k] / sum : 0.f;
+    }
+
+    if (precision == FLOAT32) {
+        for (unsigned int k = 0; k < K; k++)
+            weights[K*v + k] = normalized[k];
+        return;
+    }
+    const unsigned int maxLevel = (precision == UNORM16) ? 65535 : 255;
+    unsigned int levels[K], total = 0;
+    for (unsigned int k = 0; k < K; k++) {
+        levels[k] = (unsigned int) floor (normalized[k] * maxLevel + 0.5f);
+        total += levels[k];
+    }
+    if (sum > 0)
+        levels[0] = levels[0] + maxLevel - total;
+    for (unsigned int k = 0; k < K; k++) {
+        if (precision == UNORM16)
+            weights16[K*v + k] = uint16_t (levels[k]);
+        else
+            weights8[K*v + k] = uint8_t (levels[k]);
+    }
+}
+
+void InfluenceTable::build (const vector<Eigen::VectorXf> & boneWeights, unsigned int n) {
+    clear ();
+    if (boneWeights.size () >= NO_BONE)
+        return;
+    for (unsigned int i = 0; i < boneWeights.size (); i++)
+        if (boneWeights[i].size () != int (n))
+            return;
+    nbVertices = n;
+    nbBones = boneWeights.size ();
+    bones.assign (K * nbVertices, NO_BONE);
+    if (precision == FLOAT32)
+        weights.assign (K * nbVertices, 0.f);
+    else if (precision == UNORM16)
+        weights16.assign (K * nbVertices, 0);
+    else
+        weights8.assign (K * nbVertices, 0);
+
+    //pour chaque vertex, tri par insertion des K plus gros poids strictement positifs
+    for (unsigned int v = 0; v < nbVertices; v++) {
+        uint16_t best[K];
+        float bestWeights[K];
+        for (unsigned int k = 0; k < K; k++) {
+            best[k] = NO_BONE;
+            bestWeights[k] = 0.f;
+        }
+        for (unsigned int b = 0; b < nbBones; b++) {
+            float w = boneWeights[b][v];
+            if (!(w > bestWeights[K-1]))
+                continue;
+            unsigned int k = K - 1;
+            for (; k > 0 && w > bestWeights[k-1]; k--) {
+                best[k] = best[k-1];
+                bestWeights[k] = bestWeights[k-1];
+            }
+            best[k] = uint16_t (b);
+            bestWeights[k] = w;
+        }
+        store (v, best, bestWeights);
+    }
+}
+
+void InfluenceTable::assign (unsigned int n, unsigned int b, const uint16_t * vertexBones, const float * vertexWeights) {
+    clear ();
+    nbVertices = n;
+    nbBones = b;
+    bones.resize (K * nbVertices);
+    if (precision == FLOAT32)
+        weights.resize (K * nbVertices);
+    else if (precision == UNORM16)
+        weights16.resize (K * nbVertices);
+    else
+        weights8.resize (K * nbVertices);
+    for (unsigned int v = 0; v < nbVertices; v++)
+        store (v, vertexBones + K*v, vertexWeights + K*v);
+}
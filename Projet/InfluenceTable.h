@@ -0,0 +1,78 @@
+//
+//  InfluenceTable.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 28/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__InfluenceTable__
+#define __Projet__InfluenceTable__
+
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Dense>
+
+class InfluenceTable {
+    //influences des bones sur chaque vertex, construites après la résolution des poids : on ne garde
+    //que les K bones les plus influents par vertex, avec leurs poids normalisés (somme = 1).
+    //les K entrées d'un vertex sont contiguës (bones[K*v .. K*v+K-1]), triées par poids décroissant,
+    //les entrées inutilisées valent NO_BONE avec un poids nul.
+    //les poids peuvent être quantifiés sur 16 ou 8 bits.
+public:
+    static const unsigned int K = 4;
+    static const uint16_t NO_BONE = 0xffff;
+
+    enum Precision { FLOAT32 = 0, UNORM16, UNORM8 };
+
+    InfluenceTable () : nbVertices (0), nbBones (0), precision (FLOAT32) {}
+
+    //weights : un vecteur dense de nbVertices poids par bone (résultat de Mesh::computeWeights)
+    void build (const std::vector<Eigen::VectorXf> & weights, unsigned int nbVertices);
+    //table déjà compacte (lecture d'un .meshbin) : K bones et K poids par vertex
+    void assign (unsigned int nbVertices, unsigned int nbBones, const uint16_t * bones, const float * weights);
+    void clear ();
+    void swap (InfluenceTable & table);
+
+    //la précision est gardée par clear() et utilisée par les build() suivants
+    inline void setPrecision (Precision p) { precision = p; }
+    inline Precision getPrecision () const { return precision; }
+
+    inline bool empty () const { return nbVertices == 0; }
+    inline unsigned int getNbVertices () const { return nbVertices; }
+    inline unsigned int getNbBones () const { return nbBones; }
+
+    inline uint16_t getBone (unsigned int v, unsigned int k) const { return bones[K*v + k]; }
+    inline float getWeight (unsigned int v, unsigned int k) const {
+        switch (precision) {
+            case UNORM16: return weights16[K*v + k] * (1.f / 65535.f);
+            case UNORM8: return weights8[K*v + k] * (1.f / 255.f);
+            default: return weights[K*v + k];
+        }
+    }
+    //poids du bone sur le vertex v, 0 s'il ne fait pas partie de ses K bones
+    inline float getBoneWeight (unsigned int v, unsigned int bone) const {
+        if (v >= nbVertices)
+            return 0.f;
+        for (unsigned int k = 0; k < K; k++)
+            if (bones[K*v + k] == bone)
+                return getWeight (v, k);
+        return 0.f;
+    }
+
+    //taille occupée par la table, en octets
+    size_t memorySize () const;
+
+private:
+    void store (unsigned int v, const uint16_t * vertexBones, const float * vertexWeights);
+
+    unsigned int nbVertices;
+    unsigned int nbBones;
+    Precision precision;
+    std::vector<uint16_t> bones;
+    std::vector<float> weights;         // FLOAT32
+    std::vector<uint16_t> weights16;    // UNORM16
+    std::vector<uint8_t> weights8;      // UNORM8
+};
+
+#endif /* defined(__Projet__InfluenceTable__) */
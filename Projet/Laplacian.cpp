@@ -0,0 +1,68 @@
+//
+//  Laplacian.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 29/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "Laplacian.h"
+#include "Threads.h"
+
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+const size_t Laplacian::MIN_TRIANGLES_PER_THREAD;
+const size_t Laplacian::TRIPLETS_PER_TRIANGLE;
+
+Laplacian::Laplacian () : nbThreads (defaultNbThreads ()) {}
+
+//cotangente de l'angle entre a et b : cos/sin = (a.b) / |a x b|
+static inline float cotan (const Vec3Df & a, const Vec3Df & b) {
+    float sine = Vec3Df::crossProduct (a, b).getLength ();
+    //triangle dégénéré : pas de contribution
+    if (sine <= 1e-20f)
+        return 0.f;
+    return Vec3Df::dotProduct (a, b) / sine;
+}
+
+void Laplacian::fillTriplets (const vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                              size_t begin, size_t end, Triplet * triplets) {
+    Triplet * out = triplets + begin * TRIPLETS_PER_TRIANGLE;
+    for (size_t t = begin; t < end; t++) {
+        const Triangle & triangle = triangles[t];
+        for (unsigned int j = 0; j < 3; j++) {
+            //arête (i, k), angle opposé au sommet o
+            unsigned int i = triangle.getVertex (j);
+            unsigned int k = triangle.getVertex ((j+1)%3);
+            unsigned int o = triangle.getVertex ((j+2)%3);
+            const Vec3Df & po = vertices[o].getPos ();
+            float w = 0.5f * cotan (vertices[i].getPos () - po, vertices[k].getPos () - po);
+            *out++ = Triplet (i, k, w);
+            *out++ = Triplet (k, i, w);
+            *out++ = Triplet (i, i, -w);
+            *out++ = Triplet (k, k, -w);
+        }
+    }
+}
+
+void Laplacian::build (const vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                       Eigen::SparseMatrix<float> & L) const {
+    //chaque triangle a sa place réservée dans un seul tableau : pas de fusion après coup
+    vector<Triplet> triplets (triangles.size () * TRIPLETS_PER_TRIANGLE);
+
+    size_t nbChunks = max<size_t> (1, min<size_t> (nbThreads, triangles.size () / MIN_TRIANGLES_PER_THREAD));
+    vector<thread> workers;
+    for (size_t c = 1; c < nbChunks; c++)
+        workers.push_back (thread (&Laplacian::fillTriplets, cref (vertices), cref (triangles),
+                                   triangles.size () * c / nbChunks, triangles.size () * (c+1) / nbChunks, triplets.data ()));
+    fillTriplets (vertices, triangles, 0, triangles.size () / nbChunks, triplets.data ());
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+
+    L.resize (vertices.size (), vertices.size ());
+    //les doublons (arêtes partagées, diagonale) sont additionnés
+    L.setFromTriplets (triplets.begin (), triplets.end ());
+}
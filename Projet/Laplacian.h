@@ -0,0 +1,47 @@
+//
+//  Laplacian.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 29/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__Laplacian__
+#define __Projet__Laplacian__
+
+#include <vector>
+#include <Eigen/Sparse>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class Laplacian {
+    //Laplacienne cotangente (cf article Discrete Laplace-Beltrami Operators for Shape Analysis and Segmentation) :
+    //L(i,j) = 1/2 (cot alpha + cot beta) pour une arête ij, L(i,i) = -somme des L(i,j).
+    //L est symétrique, négative : -L + H est définie positive dès que H > 0.
+    //les cotangentes viennent directement des produits scalaire et vectoriel (pas d'acos) ; chaque thread
+    //remplit les triplets d'une tranche de triangles, et la matrice est construite d'un seul setFromTriplets.
+public:
+    Laplacian ();
+
+    inline void setNbThreads (unsigned int n) { nbThreads = n; }
+    inline unsigned int getNbThreads () const { return nbThreads; }
+
+    void build (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                Eigen::SparseMatrix<float> & L) const;
+
+    //en dessous de ce nombre de triangles par thread, on ne découpe pas
+    static const size_t MIN_TRIANGLES_PER_THREAD = 16 * 1024;
+    //triplets écrits par triangle : 3 arêtes x (2 hors diagonale + 2 sur la diagonale)
+    static const size_t TRIPLETS_PER_TRIANGLE = 12;
+
+    typedef Eigen::Triplet<float> Triplet;
+
+    static void fillTriplets (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                              size_t begin, size_t end, Triplet * triplets);
+
+private:
+    unsigned int nbThreads;
+};
+
+#endif /* defined(__Projet__Laplacian__) */
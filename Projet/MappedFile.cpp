@@ -0,0 +1,58 @@
+//
+//  MappedFile.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 20/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::~MappedFile () {
+    close ();
+}
+
+bool MappedFile::open (const string & filename) {
+    close ();
+    fd = ::open (filename.c_str (), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat (fd, &st) != 0) {
+        close ();
+        return false;
+    }
+    length = st.st_size;
+
+    //un fichier vide est valide mais mmap refuse une taille nulle
+    if (length == 0)
+        return true;
+
+    void * p = mmap (NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        close ();
+        return false;
+    }
+    //on lit le fichier une seule fois du début à la fin
+    madvise (p, length, MADV_SEQUENTIAL);
+    bytes = static_cast<const char *> (p);
+    return true;
+}
+
+void MappedFile::close () {
+    if (bytes != NULL)
+        munmap (const_cast<char *> (bytes), length);
+    if (fd != -1)
+        ::close (fd);
+    bytes = NULL;
+    length = 0;
+    fd = -1;
+}
@@ -0,0 +1,40 @@
+//
+//  MappedFile.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 20/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MappedFile__
+#define __Projet__MappedFile__
+
+#include <string>
+#include <cstddef>
+
+class MappedFile {
+    //fichier projeté en mémoire (lecture seule) : on parse directement les octets sans passer par un ifstream
+public:
+    inline MappedFile () : bytes (NULL), length (0), fd (-1) {}
+    inline MappedFile (const std::string & filename) : bytes (NULL), length (0), fd (-1) { open (filename); }
+    virtual ~MappedFile ();
+
+    bool open (const std::string & filename);
+    void close ();
+
+    inline bool isOpen () const { return fd != -1; }
+    inline const char * data () const { return bytes; }
+    inline const char * end () const { return bytes + length; }
+    inline size_t size () const { return length; }
+
+private:
+    //pas de copie : le mapping appartient à un seul objet
+    MappedFile (const MappedFile &);
+    MappedFile & operator= (const MappedFile &);
+
+    const char * bytes;
+    size_t length;
+    int fd;
+};
+
+#endif /* defined(__Projet__MappedFile__) */
@@ -0,0 +1,72 @@
+//
+//  MedianSplitBVH.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MedianSplitBVH.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+void MedianSplitBVH::build (const vector<float> & bounds, const vector<float> & centers, unsigned int leafSize,
+                            vector<Node> & nodes, vector<unsigned int> & order) {
+    nodes.clear ();
+    order.resize (centers.size () / 3);
+    for (unsigned int i = 0; i < order.size (); i++)
+        order[i] = i;
+    if (order.empty ())
+        return;
+    nodes.reserve (2 * order.size () / leafSize + 2);
+    buildNode (0, order.size (), bounds, centers, leafSize, nodes, order);
+}
+
+unsigned int MedianSplitBVH::buildNode (unsigned int begin, unsigned int end, const vector<float> & bounds,
+                                        const vector<float> & centers, unsigned int leafSize,
+                                        vector<Node> & nodes, vector<unsigned int> & order) {
+    unsigned int index = nodes.size ();
+    nodes.push_back (Node ());
+    Node node;
+    float cmin[3], cmax[3];
+    for (unsigned int c = 0; c < 3; c++) {
+        node.min[c] = cmin[c] = numeric_limits<float>::max ();
+        node.max[c] = cmax[c] = -numeric_limits<float>::max ();
+    }
+    for (unsigned int i = begin; i < end; i++) {
+        unsigned int p = order[i];
+        for (unsigned int c = 0; c < 3; c++) {
+            node.min[c] = min (node.min[c], bounds[6*p + c]);
+            node.max[c] = max (node.max[c], bounds[6*p + 3 + c]);
+            cmin[c] = min (cmin[c], centers[3*p + c]);
+            cmax[c] = max (cmax[c], centers[3*p + c]);
+        }
+    }
+    for (unsigned int c = 0; c < 3; c++) {
+        float margin = 1e-6f * max (1.f, max (fabs (node.min[c]), fabs (node.max[c])));
+        node.min[c] -= margin;
+        node.max[c] += margin;
+    }
+    node.left = node.right = 0;
+    node.first = begin;
+    node.count = end - begin;
+
+    if (end - begin > leafSize) {
+        unsigned int axis = 0;
+        for (unsigned int c = 1; c < 3; c++)
+            if (cmax[c] - cmin[c] > cmax[axis] - cmin[axis])
+                axis = c;
+        unsigned int middle = (begin + end) / 2;
+        nth_element (order.begin () + begin, order.begin () + middle, order.begin () + end,
+                     [&] (unsigned int s, unsigned int t) { return centers[3*s + axis] < centers[3*t + axis]; });
+        node.count = 0;
+        node.left = buildNode (begin, middle, bounds, centers, leafSize, nodes, order);
+        node.right = buildNode (middle, end, bounds, centers, leafSize, nodes, order);
+    }
+    nodes[index] = node;
+    return index;
+}
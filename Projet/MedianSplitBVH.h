@@ -0,0 +1,38 @@
+//
+//  MedianSplitBVH.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MedianSplitBVH__
+#define __Projet__MedianSplitBVH__
+
+#include <vector>
+
+class MedianSplitBVH {
+    //construction commune des BVH de NearestBone (segments des bones) et TriangleBVH (triangles du mesh) :
+    //chaque primitive est donnée par sa boîte et son centre. Un noeud est coupé à la médiane des centres,
+    //sur l'axe où ils sont le plus étalés, jusqu'à leafSize primitives par feuille.
+    //les boîtes des noeuds ont une petite marge pour les erreurs d'arrondi des tests (extrémité d'un segment,
+    //triangle plat sur un axe).
+public:
+    struct Node {
+        float min[3], max[3];
+        unsigned int left, right;   // fils d'un noeud interne
+        unsigned int first, count;  // primitives d'une feuille (order[first .. first+count-1]), count = 0 sinon
+    };
+
+    //bounds : 6 floats par primitive (min x y z, max x y z), centers : 3 floats par primitive.
+    //nodes reçoit l'arbre (racine en 0, vide sans primitive), order les primitives dans l'ordre des feuilles
+    static void build (const std::vector<float> & bounds, const std::vector<float> & centers, unsigned int leafSize,
+                       std::vector<Node> & nodes, std::vector<unsigned int> & order);
+
+private:
+    static unsigned int buildNode (unsigned int begin, unsigned int end, const std::vector<float> & bounds,
+                                   const std::vector<float> & centers, unsigned int leafSize,
+                                   std::vector<Node> & nodes, std::vector<unsigned int> & order);
+};
+
+#endif /* defined(__Projet__MedianSplitBVH__) */
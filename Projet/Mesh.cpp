@@ -6,24 +6,30 @@
 // ---------------------------------------------------------
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "MeshBinary.h"
+#include "MeshPLY.h"
+#include "OffReader.h"
+#include "MeshCompressed.h"
+#include "NearestBone.h"
+#include "TriangleBVH.h"
+#include "WeightCache.h"
 #include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <unordered_map>
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <OpenGL/gl.h>
-
-#include <opencv.hpp>
 
 using namespace std;
 
-static inline float cotan(float i)
-{
-    return 1/tan(i);
-}
-
 void Mesh::clear () {
     clearTopology ();
     clearGeometry ();
+    influences.clear ();
+    skinning.clear ();
+    vertexNormals.clear ();
+    skeletonStamp++;
 }
 
 void Mesh::clearGeometry () {
@@ -44,6 +50,7 @@ void Mesh::unmarkAllVertices () {
 }
 
 void Mesh::computeTriangleNormals (vector<Vec3Df> & triangleNormals) {
+    triangleNormals.reserve (triangleNormals.size () + triangles.size ());
     for (vector<Triangle>::const_iterator it = triangles.begin ();
          it != triangles.end ();
          it++) {
@@ -66,6 +73,10 @@ void Mesh::recomputeSmoothVertexNormals (unsigned int normWeight) {
         for (unsigned int  j = 0; j < 3; j++) {
             Vertex & vj = vertices[it->getVertex (j)];
             float w = 1.0; // uniform weights
+            if (normWeight == 0) {
+                vj.setNormal (vj.getNormal () + (*itNormal));
+                continue;
+            }
             Vec3Df e0 = vertices[it->getVertex ((j+1)%3)].getPos () - vj.getPos ();
             Vec3Df e1 = vertices[it->getVertex ((j+2)%3)].getPos () - vj.getPos ();
             if (normWeight == 1) { // area weight
@@ -152,262 +163,6 @@ void Mesh::markBorderEdges (EdgeMapIndex & edgeMap) {
     } 
 }
 
-inline void glVertexVec3Df (const Vec3Df & v) {
-    glVertex3f (v[0], v[1], v[2]);
-}
-
-inline void glNormalVec3Df (const Vec3Df & n) {
-    glNormal3f (n[0], n[1], n[2]);
-}
- 
-inline void glDrawPoint (const Vec3Df & pos, const Vec3Df & normal) {
-    glNormalVec3Df (normal);
-    glVertexVec3Df (pos);
-}
-
-inline void glDrawPoint (const Vertex & v) { 
-    glDrawPoint (v.getPos (), v.getNormal ()); 
-}
-
-void Mesh::renderGL (bool boneVisu, bool area, bool flat, int idx_bone) const {
-    
-    glColor3ub(232, 183, 155);
-    //glLoadName(7); plus besoin car je n'utilise plus le picking d'openGL.
-    
-    //si on est en area et qu'on a sélectionné un bone, alors on monte sa zone d'influence !
-    //seulement si on voit les bones !
-    if (boneVisu && area && idx_bone != -1){
-        
-        glBegin(GL_TRIANGLES);
-        
-        for (unsigned int i = 0; i<triangles.size(); i++){
-            const Triangle & t = triangles[i];
-            Vertex v[3];
-            for (unsigned int j = 0; j < 3; j++)
-                v[j] = vertices[t.getVertex(j)];
-            if (flat) {
-                Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
-                                                      v[2].getPos () - v[0].getPos ());
-                normal.normalize ();
-                glNormalVec3Df (normal);
-            }
-            for (unsigned int j = 0; j < 3; j++){
-                if (weights[idx_bone](t.getVertex(j)) >0){
-                    glColor3f(1.0, 0.0, 0.0);
-                }else{
-                    glColor3ub(232, 183, 155);
-                }
-                if (!flat)
-                    glDrawPoint (v[j]);
-                else
-                    glVertexVec3Df (v[j].getPos ());
-            }
-                
-        }
-        glEnd ();
-
-        
-    }else{
-        //on ne montre pas la zone d'influence des bones, donc on affiche le mesh classique
-        glBegin (GL_TRIANGLES);
-        for (unsigned int i = 0; i < triangles.size (); i++) {
-            const Triangle & t = triangles[i];
-            Vertex v[3];
-            for (unsigned int j = 0; j < 3; j++)
-                v[j] = vertices[t.getVertex(j)];
-            if (flat) {
-                Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
-                                                      v[2].getPos () - v[0].getPos ());
-                normal.normalize ();
-                glNormalVec3Df (normal);
-            }
-            for (unsigned int j = 0; j < 3; j++)
-                if (!flat)
-                    glDrawPoint (v[j]);
-                else
-                    glVertexVec3Df (v[j].getPos ());
-        }
-        glEnd ();
-    }
-    
-    //seulement si on veut voir les bones !
-    if (boneVisu){
-        
-        //dessiner le skelette
-        glColor3f(0.0, 0.0, 1.0);
-        glLineWidth(2);
-        glBegin (GL_LINES);
-        
-        for (unsigned int i=0; i< bones.size(); i++){
-            //on dessine seulement les bones non sélectionnés
-            if (i != idx_bone){
-                Armature* b = bones[i];
-                //on dessine une ligne seulement si c'est un bone !
-                if (b->getType() == "bone"){
-                    Vertex v[2];
-                    for (unsigned int j=0; j<2; j++)
-                        v[j] = vertices_bones[b->getVertex(j)];
-                    
-                    for (unsigned int j=0; j<2; j++){
-                        glVertexVec3Df (v[j].getPos ());
-                    }
-                }
-            }
-            
-        }
-        glEnd();
-        
-        for (unsigned int i =0; i<bones.size(); i++){
-            if (i != idx_bone){
-                
-                Armature * h = bones[i];
-                //on dessine le point seulement si c'est une handle
-                if (h->getType() == "handle"){
-                    Vertex v = vertices_bones[h->getVertex()];
-                    this->drawSphere(5, 5, v.getPos());
-                }
-            }
-        }
-        
-        // si idx_bone !=-1, on a sélectionné un bone et on le colorie d'une couleur différente
-        if(idx_bone != -1){
-            
-            if (bones[idx_bone]->getType() == "bone"){
-                //c'est un bone donc une ligne
-                glColor3f(1., 0., 0.);
-                glLineWidth(2);
-                glBegin (GL_LINES);
-                
-                Vertex v[2];
-                for (unsigned int j=0; j<2; j++)
-                    v[j] = vertices_bones[bones[idx_bone]->getVertex(j)];
-                
-                for (unsigned int j=0; j<2; j++){
-                    glVertexVec3Df (v[j].getPos ());
-                }
-                glEnd();
-                
-            }else{
-                //c'est un handle donc un point
-                glColor3f(1., 0., 0.);
-                Vertex v = vertices_bones[bones[idx_bone]->getVertex()];
-                this->drawSphere(5, 5, v.getPos());
-                
-            }
-        }
-
-    }
-        
-}
-
-void Mesh::drawSphere(unsigned int resU, unsigned int resV, Vec3Df pos) const{
-    
-    std::vector<Vertex> V(resU * (resV-2) + 2);
-    std::vector<Triangle> T(resU * (resV-2)*2 + 2*resU);
-    
-    // resU pas en theta
-    // resV pas en phi
-    int count = 0;
-    float x,y,z,theta,phi;
-    // en coordonnées sphériques, avec r = 1;
-    // on ajoute à la main le pole nord
-    V[count].setPos(Vec3Df(0,1,0));
-    count++;
-    for(unsigned int i = 0; i < resU; i++)
-    {
-        theta = 2*M_PI*i/resU;
-        //cout << "theta = " << theta << endl;
-        for(unsigned int j = 1 ; j < (resV-1) ; j++)
-        {
-            phi = M_PI*j/(resV-1);
-            //cout << "Phi " << phi << endl;
-            x = sin(phi)*sin(theta);
-            y = cos(phi);
-            z = sin(phi)*cos(theta);
-            
-            V[count].setPos(Vec3Df(x,y,z));
-            count ++;
-        }
-    }
-    // on ajoute à la main le pole sud
-    int max = count;
-    V[count].setPos(Vec3Df(0,-1,0));
-    
-    //construction voisinnage pole nord
-    count = 0;
-    for (unsigned int i = 0; i < resU; i++)
-    {
-        T[i].setVertex(0, 0 %(resU*(resV-2)));
-        T[i].setVertex(1, (count + 1)%(resU*(resV-2)));
-        T[i].setVertex(2, (count + 1 + resV-2)%(resU*(resV-2)));
-        
-        count += resV-2;
-    }
-    
-    //on décompose les quadrilatere logiquement obtenu par la construction des points de la sphere
-    // en 2 triangles.
-    for(unsigned int j = 0 ; j < resU ; j++)//resU ppour valeur finale j
-    {
-        for (unsigned int i = 1; i < resV-2; i++)
-        {
-            if(j != resU-1){
-                //premier triangle du carré
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)));
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2)+ 1));
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(2, ( i + j*(resV-2)+ 1 + resV-2));
-                
-                //2eme triangle du carré
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)+ 1+ (resV-2)));
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2) + (resV-2)));
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(2, (i + j*(resV-2)));
-                
-            }
-            //On fait attention au raccordement entre derniers indices et premiers indices
-            else{
-                //premier triangle du carré
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)));
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2)+ 1));
-                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(2, ( i +1));
-                
-                //2eme triangle du carré
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(0, ( i +1));
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(1, i);
-                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(2, (i + j*(resV-2)));
-                
-            }
-        }
-    }
-    
-    //construction voisinnage pole sud
-    count = 0;
-    for (unsigned int i = T.size()-resU; i < T.size(); i++)
-    {
-        T[i].setVertex(0, max);
-        T[i].setVertex(1, (count + resV-2)%(resU*(resV-2)) + resV-2);
-        T[i].setVertex(2, (count)%(resU*(resV-2)) + resV-2);
-        
-        count += resV-2;
-    }
-    
-    Mesh mesh = Mesh(V, T);
-    mesh.recomputeSmoothVertexNormals(0);
-    mesh.centerToCandScaleToF(pos, 0.3);
-    
-    //je dessine ensuite ces vertices et triangles
-    //glTranslatef(pos[0], pos[1], pos[2]);
-    glBegin (GL_TRIANGLES);
-    for (unsigned int i = 0; i < mesh.getTriangles().size(); i++) {
-        const Triangle & t = mesh.getTriangles()[i];
-        Vertex v[3];
-        for (unsigned int j = 0; j < 3; j++)
-            v[j] = mesh.getVertices()[t.getVertex(j)];
-        for (unsigned int j = 0; j < 3; j++)
-            glDrawPoint (v[j]);
-    }
-    glEnd ();
-    
-}
-
 void Mesh::centerToCandScaleToF(Vec3Df c, float f){
     Vec3Df center;
     for (unsigned int i = 0; i< vertices.size(); i++){
@@ -430,138 +185,163 @@ void Mesh::centerToCandScaleToF(Vec3Df c, float f){
     
 }
 
-void Mesh::loadOFF (const std::string & filename) {
+unsigned int Mesh::load (const std::string & filename, float weldTolerance, unsigned int nbThreads) {
+    //choix du format selon l'extension du fichier
+    string extension = filename.substr (filename.find_last_of ('.') + 1);
+    transform (extension.begin (), extension.end (), extension.begin (), ::tolower);
+    unsigned int welded = 0;
+    if (extension == "off")
+        welded = loadOFF (filename, weldTolerance);
+    else if (extension == "obj")
+        welded = loadOBJ (filename, weldTolerance, nbThreads);
+    else if (extension == "ply")
+        welded = loadPLY (filename, weldTolerance);
+    else if (extension == "meshbin")
+        MeshBinary::load (*this, filename);
+    else if (extension == "qmesh")
+        MeshCompressed::load (*this, filename);
+    else
+        throw Exception ("Unknown mesh format: " + filename);
+    return welded;
+}
+
+unsigned int Mesh::loadOFF (const std::string & filename, float weldTolerance) {
     clear ();
-    ifstream input (filename.c_str ());
-    if (!input)
-        throw Exception ("Failing opening the file.");
-    string magic_word;
-    input >> magic_word;
-    if (magic_word != "OFF")
-        throw Exception ("Not an OFF file.");
-    unsigned int numOfVertices, numOfTriangles, numOfWhat;
-    input >> numOfVertices >> numOfTriangles >> numOfWhat;
-    for (unsigned int i = 0; i < numOfVertices; i++) {
-        Vec3Df pos;
-        Vec3Df col;
-        input >> pos;
-        vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
-    }
-    for (unsigned int i = 0; i < numOfTriangles; i++) {
-        unsigned int polygonSize;
-        input >> polygonSize;
-        vector<unsigned int> index (polygonSize);
-        for (unsigned int j = 0; j < polygonSize; j++)
-            input >> index[j];
-        for (unsigned int j = 1; j < (polygonSize - 1); j++)
-            triangles.push_back (Triangle (index[0], index[j], index[j+1]));
-    }
-    input.close ();
+    //le fichier est projeté en mémoire et parsé directement (beaucoup plus rapide que ifstream >>)
+    OffReader reader;
+    reader.open (filename);
+    reader.readVertices (vertices);
+    reader.readFaces (triangles);
+    unsigned int welded = (weldTolerance >= 0) ? weldVertices (weldTolerance) : 0;
     recomputeSmoothVertexNormals (0);
+    return welded;
 }
 
-void Mesh::loadOBJ(const std::string &filename) {
+unsigned int Mesh::loadPLY (const std::string & filename, float weldTolerance) {
+    clear ();
+    MeshPLY::load (*this, filename);
+    unsigned int welded = (weldTolerance >= 0) ? weldVertices (weldTolerance) : 0;
+    recomputeSmoothVertexNormals (0);
+    return welded;
+}
+
+unsigned int Mesh::loadOBJ(const std::string &filename, float weldTolerance, unsigned int nbThreads) {
     
     clear();
-    ifstream input (filename.c_str ());
-    if (!input)
+    MappedFile file (filename);
+    if (!file.isOpen ())
         throw Exception ("Failing opening the file.");
 
     if (filename.find("obj") == 0)
         throw Exception ("Not an OBJ file");
 
-    string word;
-    std::getline(input, word);
-    //permet de savoir si on est dans un objet ou dans un skelette. (si objet -> true)
-    bool obj;
+    //lecture en parallèle par morceaux (cf ObjParser) : même sémantique que l'ancienne lecture ligne à ligne
+    //"o" -> objet, "s" -> squelette, "l" -> bone, "lv" -> handle
+    ObjParser parser;
+    if (nbThreads != 0)
+        parser.setNbThreads (nbThreads);
+    parser.parse (file, vertices, triangles, vertices_bones, bones);
+    
+    //les exports de blender dupliquent les vertices le long des coutures (uv, normales)
+    unsigned int welded = (weldTolerance >= 0) ? weldVertices (weldTolerance) : 0;
     
-    while ( word.length() != 0){
+    recomputeSmoothVertexNormals (0);
+    return welded;
+    
+}
 
-        istringstream iss(word);
-        
-        vector<string> line{istream_iterator<string>{iss},
-            istream_iterator<string>{}};
+static inline unsigned long long weldCellKey (long long x, long long y, long long z) {
+    //21 bits par axe
+    const long long mask = (1 << 21) - 1;
+    return ((unsigned long long) (x & mask) << 42) | ((unsigned long long) (y & mask) << 21) | (unsigned long long) (z & mask);
+}
+
+unsigned int Mesh::weldVertices (float tolerance) {
+    
+    //fusion des vertices confondus à tolerance près : table de hachage spatiale de cellules de taille tolerance,
+    //on ne compare un vertex qu'aux représentants déjà gardés dans les 27 cellules voisines
+    if (vertices.empty ())
+        return 0;
+    
+    Vec3Df min = vertices[0].getPos (), max = vertices[0].getPos ();
+    for (unsigned int i = 1; i < vertices.size (); i++)
+        for (unsigned int j = 0; j < 3; j++) {
+            min[j] = std::min (min[j], vertices[i].getPos ()[j]);
+            max[j] = std::max (max[j], vertices[i].getPos ()[j]);
+        }
+    //tolerance nulle : seulement les positions identiques, avec une cellule minuscule
+    float cellSize = std::max (tolerance, 1e-7f * Vec3Df::distance (min, max));
+    if (cellSize <= 0)
+        cellSize = 1.f;
+    float tolerance2 = tolerance * tolerance;
+    
+    const unsigned int none = (unsigned int) -1;
+    unordered_map<unsigned long long, unsigned int> cells;
+    cells.reserve (vertices.size ());
+    vector<unsigned int> nextInCell;        // liste chaînée des représentants d'une cellule
+    vector<unsigned int> remap (vertices.size ());
+    vector<Vertex> welded;
+    welded.reserve (vertices.size ());
+    
+    for (unsigned int i = 0; i < vertices.size (); i++) {
+        const Vec3Df & p = vertices[i].getPos ();
+        long long c[3];
+        for (unsigned int j = 0; j < 3; j++)
+            c[j] = (long long) floor ((p[j] - min[j]) / cellSize);
+        
+        unsigned int found = none;
+        for (int dx = -1; dx <= 1 && found == none; dx++)
+            for (int dy = -1; dy <= 1 && found == none; dy++)
+                for (int dz = -1; dz <= 1 && found == none; dz++) {
+                    unordered_map<unsigned long long, unsigned int>::const_iterator it = cells.find (weldCellKey (c[0] + dx, c[1] + dy, c[2] + dz));
+                    if (it == cells.end ())
+                        continue;
+                    for (unsigned int k = it->second; k != none; k = nextInCell[k]) {
+                        if (Vec3Df::squaredDistance (welded[k].getPos (), p) <= tolerance2) {
+                            found = k;
+                            break;
+                        }
+                    }
+                }
         
-        //avant de remplir les vertices, on regarde si on a un skelette ou un objet.
-        if (line[0] == "o"){
-            obj = true;
-            std::getline(input, word);
-            line.clear();
-        }else if (line [0] == "s") {
-           obj = false;
-            std::getline(input, word);
-            line.clear();
-            
-        }else if (word.find("#") != std::string::npos){
-            std::getline(input, word);
-            line.clear();
-            
-        }else if ( line[0] == "v"){
-            //je lis une ligne de vertex v
-            //il faut récupérer les 3 positions
-            
-            //si c'est un objet on remplir les vertices du mesh
-            //sinon, on remplit les vertices du skelette
-            if (obj){
-                Vec3Df pos( atof(line[1].c_str()) , atof(line[2].c_str()), atof(line[3].c_str()) );
-                vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
-           }else{
-                Vec3Df pos( atof(line[1].c_str()) , atof(line[2].c_str()), atof(line[3].c_str()) );
-                vertices_bones.push_back( Vertex(pos, Vec3Df (1.0, 0.0, 0.0)) );
-            }
-            
-            std::getline(input, word);
-            
-        }else if( line[0] == "f"){
-            //je lis une ligne de face
-            unsigned int polygonSize = line.size();
-            
-            if (polygonSize == 4){
-                //c'est un triangle
-                //on enlève 1 car dans un .obj, l'index des vertices commencent à 1 et non 0 !
-                triangles.push_back (Triangle (atof(line[1].c_str())-1, atof(line[2].c_str())-1, atof(line[3].c_str())-1));
+        if (found == none) {
+            //nouveau représentant
+            found = welded.size ();
+            welded.push_back (vertices[i]);
+            unsigned long long key = weldCellKey (c[0], c[1], c[2]);
+            unordered_map<unsigned long long, unsigned int>::iterator it = cells.find (key);
+            if (it == cells.end ()) {
+                nextInCell.push_back (none);
+                cells[key] = found;
+            } else {
+                nextInCell.push_back (it->second);
+                it->second = found;
             }
-            std::getline(input, word);
-            
-        }else if (line[0] == "l"){
-            // c'est un bone
-            
-            if (line.size() == 3){
-                // c'est une ligne
-                //on enlève 1 car dans un .obj, l'index des vertices commencent à 1 et non 0
-                //on enlève la taille des vertices précédents !
-                unsigned int index1 = atof(line[1].c_str())-1-vertices.size();
-                unsigned int index2 = atof(line[2].c_str())-1-vertices.size();
-                Bone* bone = new Bone(index1, index2);
-                bone->buildBox(vertices_bones[index1], vertices_bones[index2]);
-                bones.push_back(bone);
-            }
-            std::getline(input, word);
-            
-        }else if (line[0] == "lv"){
-            
-            // c'est un handle
-            if (line.size() == 2){
-                // c'est un handle
-                unsigned int index = atof(line[1].c_str())-1-vertices.size();
-                Handle* handle = new Handle(index);
-                handle->buildBox(vertices_bones[index]);
-                bones.push_back(handle);
-            }
-            
-            std::getline(input, word);
-            
-        }else{
-            
-            std::getline(input, word);
-            
         }
-        
+        remap[i] = found;
     }
     
-    input.close();
-    recomputeSmoothVertexNormals (0);
+    unsigned int removed = vertices.size () - welded.size ();
+    if (removed == 0)
+        return 0;
     
+    //on renumérote les triangles et on enlève ceux qui sont devenus dégénérés
+    vector<Triangle> remapped;
+    remapped.reserve (triangles.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        unsigned int v0 = remap[triangles[i].getVertex (0)];
+        unsigned int v1 = remap[triangles[i].getVertex (1)];
+        unsigned int v2 = remap[triangles[i].getVertex (2)];
+        if (v0 != v1 && v1 != v2 && v0 != v2)
+            remapped.push_back (Triangle (v0, v1, v2));
+    }
+    
+    vertices.swap (welded);
+    triangles.swap (remapped);
+    //les poids calculés correspondent à l'ancienne numérotation
+    influences.clear ();
+    
+    return removed;
 }
 
 void Mesh::rotateAroundZ(float angle)
@@ -574,6 +354,13 @@ void Mesh::rotateAroundZ(float angle)
         newV[1] = -sin(angle) * V[0] + cos(angle) * V[1];
         newV[2] = V[2];
         vertices[i].setPos(newV);
+        //rotation : les normales tournent de la même façon
+        Vec3Df N = vertices[i].getNormal();
+        Vec3Df newN;
+        newN[0] = cos(angle) * N[0] + sin(angle) * N[1];
+        newN[1] = -sin(angle) * N[0] + cos(angle) * N[1];
+        newN[2] = N[2];
+        vertices[i].setNormal(newN);
     }
     for (int i = 0; i < vertices_bones.size(); i++) {
         Vec3Df newV;
@@ -583,7 +370,7 @@ void Mesh::rotateAroundZ(float angle)
         newV[2] = V[2];
         vertices_bones[i].setPos(newV);
     }
-    recomputeSmoothVertexNormals(0);
+    unbindPose();
 }
 
 void Mesh::rotateAroundY(float angle)
@@ -596,6 +383,13 @@ void Mesh::rotateAroundY(float angle)
         newV[1] = V[1];
         newV[2] = -sin(angle) * V[0] + cos(angle) * V[2];
         vertices[i].setPos(newV);
+        //rotation : les normales tournent de la même façon
+        Vec3Df N = vertices[i].getNormal();
+        Vec3Df newN;
+        newN[0] = cos(angle) * N[0] + sin(angle) * N[2];
+        newN[2] = -sin(angle) * N[0] + cos(angle) * N[2];
+        newN[1] = N[1];
+        vertices[i].setNormal(newN);
     }
     for (int i = 0; i < vertices_bones.size(); i++) {
         Vec3Df newV;
@@ -605,7 +399,7 @@ void Mesh::rotateAroundY(float angle)
         newV[2] = -sin(angle) * V[0] + cos(angle) * V[2];
         vertices_bones[i].setPos(newV);
     }
-    recomputeSmoothVertexNormals(0);
+    unbindPose();
 }
 
 void Mesh::rotateAroundX(float angle)
@@ -618,6 +412,13 @@ void Mesh::rotateAroundX(float angle)
         newV[1] = cos(angle) * V[1] + sin(angle) * V[2];
         newV[2] = -sin(angle) * V[1] + cos(angle) * V[2];
         vertices[i].setPos(newV);
+        //rotation : les normales tournent de la même façon
+        Vec3Df N = vertices[i].getNormal();
+        Vec3Df newN;
+        newN[1] = cos(angle) * N[1] + sin(angle) * N[2];
+        newN[2] = -sin(angle) * N[1] + cos(angle) * N[2];
+        newN[0] = N[0];
+        vertices[i].setNormal(newN);
     }
     for (int i = 0; i < vertices_bones.size(); i++) {
         Vec3Df newV;
@@ -627,7 +428,7 @@ void Mesh::rotateAroundX(float angle)
         newV[2] = -sin(angle) * V[1] + cos(angle) * V[2];
         vertices_bones[i].setPos(newV);
     }
-    recomputeSmoothVertexNormals(0);
+    unbindPose();
     
 }
 
@@ -686,76 +487,40 @@ void Mesh::makeCube(const Vec3Df & v0, const Vec3Df & v1, vector<Vec3Df> & vert,
     tri.push_back(Triangle(7,4,3));
 }
 
-//méthode d'affichage des handles autre que les sphères (non utilisé ici)
-void Mesh::drawBoundingBox(int idx_bone) const {
-    BoundingBox box = bones[idx_bone]->getBoundingBox();
-    Vec3Df center = box.getCenter();
-  
-    Vec3Df min = box.getMin();
-    Vec3Df max = box.getMax();
-    Vec3Df v2(min[0] + box.getLength(), min[1], min[2]);
-    Vec3Df v3(min[0] + box.getLength(), min[1] + box.getHeight(), min[2]);
-    Vec3Df v4(min[0], min[1] + box.getLength(), min[2]);
-    Vec3Df v5(max[0] - box.getLength(), max[1] - box.getHeight(), max[2]);
-    Vec3Df v6(max[0], max[1] - box.getHeight(), max[2]);
-    Vec3Df v7(max[0] - box.getLength(), max[1], max[2]);
-    
-    glBegin(GL_QUADS);
-        glDrawPoint (min);
-        glDrawPoint (v2);
-        glDrawPoint (v3);
-        glDrawPoint (v4);
-    
-        glDrawPoint (max);
-        glDrawPoint (v7);
-        glDrawPoint (v4);
-        glDrawPoint (v3);
-    
-        glDrawPoint (max);
-        glDrawPoint (v3);
-        glDrawPoint (v2);
-        glDrawPoint (v6);
+void Mesh::bindPose(){
     
-        glDrawPoint (v7);
-        glDrawPoint (max);
-        glDrawPoint (v6);
-        glDrawPoint (v5);
-    
-        glDrawPoint (v2);
-        glDrawPoint (min);
-        glDrawPoint (v5);
-        glDrawPoint (v6);
-    
-        glDrawPoint (v4);
-        glDrawPoint (v7);
-        glDrawPoint (v5);
-        glDrawPoint (min);
-    
-    glEnd();
+    if (skinning.isBound() && skinning.getNbVertices() == vertices.size() && skinning.getNbBones() == bones.size()){
+        return;
+    }
+    //les poids doivent correspondre au mesh et au squelette de repos
+    if (influences.getNbVertices() != vertices.size() || influences.getNbBones() != bones.size()){
+        initWeights();
+    }
+    skinning.bind(vertices, vertices_bones, bones, influences);
+    vertexNormals.build(vertices, triangles);
 }
 
-void Mesh::modifyMesh(const int & idx_bone, const Vec3Df & x_displacement, const Vec3Df & y_displacement){
-    
-    // modification du mesh
-    //calcul du poids des différents bones pour chaque vertex du mesh
-    
-    //std::vector <Eigen::VectorXf> w;
-    computeWeights(weights);
-    
-    //modification de la position des différents vertices du mesh selon LBS.
-    // pas de sommes des contributions des différents bones car on ne modifie qu'un bone à la fois pour l'instant
+void Mesh::unbindPose(){
+    skinning.clear();
+}
+
+void Mesh::editSkeleton(){
+    unbindPose();
+    skeletonStamp++;
+}
+
+void Mesh::deform(){
     
-    for (unsigned int i = 0; i< vertices.size() ; i++){
-        
-        if (weights[idx_bone][i] != 0){
-            vertices[i].getPos();
-            Vertex vert = Vertex( weights[idx_bone][i] * vertices[i].getPos() + x_displacement + y_displacement);
-            setMeshVertices(i, vert);
-        }
+    // modification du mesh selon LBS : chaque vertex est la somme des transformations de ses K bones
+    // appliquées à sa position au repos (pas d'accumulation d'un déplacement à l'autre)
+    bindPose();
+    skinning.setPose(vertices_bones, bones);
+    std::vector<unsigned int> moved;
+    skinning.apply(vertices, &moved);
+    //normales sur la surface déformée, seulement autour des vertices déplacés
+    if (!moved.empty()){
+        vertexNormals.update(vertices, triangles, moved);
     }
-    
-    recomputeSmoothVertexNormals(0);
-    
 }
 
 void Mesh::modifyBone(const int & idx_bone, const Vec3Df & x_displacement, const Vec3Df & y_displacement, bool end_displacement){
@@ -774,7 +539,6 @@ void Mesh::modifyBone(const int & idx_bone, const Vec3Df & x_displacement, const
         
         if(end_displacement){
             dynamic_cast<Bone*>(bones[idx_bone])->buildBox(new0, new1);
-            computeWeights(weights);
         }
         
     }else if ( bones[idx_bone]->getType() == "handle"){
@@ -786,26 +550,22 @@ void Mesh::modifyBone(const int & idx_bone, const Vec3Df & x_displacement, const
         
         if (end_displacement){
             dynamic_cast<Handle*>(bones[idx_bone])->buildBox(new0);
-            computeWeights(weights);
         }
         
     }
 
 }
 
-void Mesh::addHandle(Vertex vert, bool influenceArea){
+void Mesh::addHandle(Vertex vert){
     
     vertices_bones.push_back(vert);
     Handle * handle = new Handle(vertices_bones.size() - 1);
     handle->buildBox(vertices_bones[vertices_bones.size() - 1]);
     bones.push_back(handle);
+    //la pose actuelle devient la pose de repos du nouveau squelette
+    editSkeleton();
     
-    //si la case des influenceArea est cohé, l'utilisateur peut directement
-    //recliqué sur le nouveau handle, il faut donc recalculé les poids
-    //si la case influenceArea n'est pas coché, pas besoin car quand elle sera coché le calcul sera effectué !
-    if (influenceArea){
-        computeWeights(weights);
-    }
+    //les poids ne sont plus à jour : c'est GLViewer qui relance leur calcul (en arrière-plan) si besoin
                                  
 }
 
@@ -816,6 +576,8 @@ void Mesh::suppr(int idx_bone){
     
     if (idx_bone != -1){
         
+        editSkeleton();
+        
         if (bones[idx_bone]->getType() == "bone"){
             
             int idx_vertices = bones[idx_bone]->getVertex(0);
@@ -897,121 +659,116 @@ void Mesh::suppr(int idx_bone){
     
 }
 
-void Mesh::computeWeights(std::vector < Eigen::VectorXf> & w){
-    
-    //on calcule la matrice Laplacienne (cf article Discrete Laplace-Beltrami Operators for Shape Analysis and Segmentation pour savoir comment faire)
-    
-    w.clear();
+void Mesh::initWeights(Progress * progress, bool cached){
+    //la pose de repos est à reprendre avec les nouveaux poids
+    unbindPose();
+    
+    //mêmes vertices, triangles et squelette qu'une résolution précédente : on relit ses poids (cf WeightCache)
+    WeightCache & cache = WeightCache::shared();
+    cached = cached && cache.isEnabled() && !bones.empty();
+    uint64_t key = 0;
+    if (cached){
+        key = WeightCache::key(vertices, triangles, vertices_bones, bones);
+        if (cache.load(key, vertices.size(), bones.size(), influences)){
+            return;
+        }
+    }
     
-    //il faut calculer la matrice W = wij et V
-    Eigen::SparseMatrix<float> W(vertices.size(), vertices.size() );
-    W.setZero();
+    std::vector <Eigen::VectorXf> w;
+    computeWeights(w, progress);
+    influences.build(w, vertices.size());
     
-    Eigen::SparseMatrix<float> V(vertices.size(), vertices.size() );
-    V.setZero();
+    if (cached && influences.getNbBones() == bones.size()){
+        cache.store(key, influences);
+    }
+}
+
+void Mesh::previewWeights(){
     
-    for (unsigned int i=0 ; i< triangles.size() ; i++){
-        
-        Triangle t = triangles[i];
-        
-        for (unsigned int j = 0; j < 3 ; j++){
-            
-            Vec3Df vj = vertices[ t.getVertex(j)].getPos();
-            Vec3Df vj1 = vertices[ t.getVertex((j+1)%3)].getPos();
-            Vec3Df vj2 = vertices[ t.getVertex((j+2)%3)].getPos();
-            
-            //ATTENTION ACOS DOIT PRENDRE EN RADIAN !!
-            float angle = acos( Vec3Df::dotProduct(vj1-vj2, vj - vj2) / (Vec3Df::distance(vj1, vj2) * Vec3Df::distance(vj, vj2) ) ) * 180 / M_PI;
-            float angle2 = acos (Vec3Df::dotProduct( vj2 - vj1, vj - vj1) / (Vec3Df::distance(vj1, vj2) * Vec3Df::distance(vj, vj1) ) ) * 180 / M_PI;
-            
-            W.coeffRef(t.getVertex(j), t.getVertex( (j+1)%3)) += 1/2 * cotan(angle);
-            V.coeffRef(t.getVertex(j), t.getVertex(j) ) += 1/2 * (cotan(angle) + cotan(angle2));
-            
+    //distance de chaque vertex à chaque bone (segment, ou point pour un handle), poids en 1/d^4 :
+    //O(vertices x bones), sans système à résoudre ; InfluenceTable garde les K plus forts et normalise
+    std::vector <Eigen::VectorXf> w(bones.size(), Eigen::VectorXf(vertices.size()));
+    for (unsigned int b = 0; b< bones.size(); b++){
+        Vec3Df a = vertices_bones[bones[b]->getVertex(0)].getPos();
+        Vec3Df d = Vec3Df(0, 0, 0);
+        if (bones[b]->getType() == "bone"){
+            d = vertices_bones[bones[b]->getVertex(1)].getPos() - a;
+        }
+        float length2 = Vec3Df::dotProduct(d, d);
+        float inv = (length2 > 0) ? 1.f/length2 : 0.f;
+        for (unsigned int i = 0; i< vertices.size(); i++){
+            Vec3Df p = vertices[i].getPos() - a;
+            float t = std::min(1.f, std::max(0.f, Vec3Df::dotProduct(p, d) * inv));
+            float d2 = (p - t*d).getSquaredLength();
+            w[b](i) = 1.f/(d2*d2 + 1e-12f);
         }
     }
+    influences.build(w, vertices.size());
+    unbindPose();
+}
+
+void Mesh::swapInfluences(InfluenceTable & table){
+    influences.swap(table);
+    //arrivés pendant une pose : les vertices ne sont plus au repos, on garde la pose de repos liée
+    //et on recalcule la pose courante avec les nouveaux poids
+    if (skinning.isBound() && skinning.getNbVertices() == influences.getNbVertices() && skinning.getNbBones() == influences.getNbBones()){
+        skinning.setInfluences(influences);
+        deform();
+    }else{
+        unbindPose();
+    }
+}
+
+void Mesh::computeWeights(std::vector < Eigen::VectorXf> & w, Progress * progress){
     
-    //La matrice Laplacienne est L = D^-1.A
-    // pour l'instant j'ai pris D = Id mais on pourrait prendre l'aire de la cellule de Voronoi
+    w.clear();
     
-    Eigen::SparseMatrix<float> L(vertices.size() , vertices.size() );
-    L.setZero();
+    //sans bone il n'y a aucun système à résoudre
+    if (bones.empty()){
+        return;
+    }
     
-    L = V - W;
+    //la Laplacienne cotangente L est construite (cf Laplacian) et gardée par weightSolver
     
     //on calcule la matrice H diagonale (cf article 2007 Baran and Popovic)
-    //et on définit pour chaque vertex, le bone le plus proche !
-    Eigen::SparseMatrix<float> H(vertices.size(), vertices.size());
-    H.setZero();
-
+    //et on définit pour chaque vertex, le bone visible le plus proche (distance au segment, cf NearestBone) :
+    //le segment du vertex au bone doit rester à l'intérieur du mesh (test contre un BVH des triangles)
+    NearestBone nearest;
+    nearest.build(vertices_bones, bones);
+    TriangleBVH surface;
+    surface.build(vertices, triangles);
+    std::vector<NearestBone::Result> closest;
+    nearest.queryVisible(vertices, surface, closest, progress);
+    
+    Eigen::VectorXf H(vertices.size());
     for (unsigned int i = 0; i< vertices.size(); i++){
-        
-        //on recheche le bone le plus proche du vertex i
-        float dist_min = MAXFLOAT;
-        int nb_bones = 0;
-        
-        for (unsigned int j = 0 ; j<bones.size() ; j++){
-            for (unsigned int k = 0 ; k<2; k++){
-                
-                // il faut que je vérifie que le segment est inclu à l'intérieur du mesh !!
-                
-                float distance = Vec3Df::distance(vertices_bones[ bones[j]->getVertex(k)].getPos(), vertices[i].getPos());
-                
-                if (distance < dist_min) {
-                    dist_min = distance;
-                    nb_bones = 1;
-                    vertices[i].setBone(j);
-                }
-                if (distance == dist_min){
-                    nb_bones++;
-                }
-            }
-        }
-        
-        H.insert(i,i) = nb_bones * 1/dist_min;
+        vertices[i].setBone(closest[i].bone);
+        H(i) = closest[i].nbTies * 1/closest[i].distance;
     }
     
+    //on veut résoudre (-L + H) wi = H pi pour chaque bone i : la matrice ne dépend pas du bone,
+    //elle est factorisée une seule fois et tous les seconds membres sont résolus d'un coup (une colonne par bone)
     
-    Eigen::SparseMatrix<float> A(vertices.size(), vertices.size());
-    //on veut résoudre A wi = b;
-    // cette résolution doit se faire pour chaque bone !! i = ith bone !!
-    std:vector < Eigen::VectorXf > p;
-    
-    for (unsigned int i = 0 ; i< bones.size(); i++){
-        
-        //on calcule pi qui est le vecteur pour le bone i
-        Eigen::VectorXf pi(vertices.size());
-        
-        for (unsigned int j = 0; j< vertices.size(); j++){
-            if (vertices[j].getBone() == i){
-                pi(j) = 1;
-            }else{
-                pi(j) = 0;
-            }
+    //pi est le vecteur indicateur du bone i : 1 pour les vertices dont c'est le bone le plus proche
+    Eigen::MatrixXf P = Eigen::MatrixXf::Zero(vertices.size(), bones.size());
+    for (unsigned int j = 0; j< vertices.size(); j++){
+        if (vertices[j].getBone() >= 0 && vertices[j].getBone() < (int)bones.size()){
+            P(j, vertices[j].getBone()) = 1;
         }
-        
-        p.push_back(pi);
-        
     }
     
+    Eigen::MatrixXf B = H.asDiagonal() * P;
+    Eigen::MatrixXf X;
+    
+    if (!weightSolver.solve(vertices, triangles, H, B, X, progress)) {
+        //decomposition failed
+        cout << " il y a une erreur dans la résolution du système " << endl;
+        return;
+    }
+    
+    w.reserve(bones.size());
     for (unsigned int i = 0; i< bones.size() ; i++){
-        
-        Eigen::VectorXf wi(vertices.size()), b(vertices.size());
-        A = -L + H;
-        b = H * p[i];
-            
-        Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> > solver;
-        solver.compute(A);
-        
-        if (solver.info() != Eigen::Success) {
-            //decomposition failed
-            cout << " il y a une erreur dans la résolution du système " << endl;
-            cout << "type d'erreur : " << solver.info() << endl;
-            return;
-        }
-        
-        wi = solver.solve(b);
-        
-        w.push_back(wi);
+        w.push_back(X.col(i));
     }
     
     //test des wi - il faut que la somme pour un vertex des wi soit égal à 1 !
@@ -1023,7 +780,7 @@ void Mesh::computeWeights(std::vector < Eigen::VectorXf> & w){
             sum_test += w[i][j];
         }
         
-        if (sum_test > 1){
+        if (sum_test > 1.01){
             cout << sum_test << "sum" << endl;
             cout << "error pour wi ! " << endl;
             return;
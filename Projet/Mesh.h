@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
@@ -18,20 +19,45 @@
 #include "Edge.h"
 #include "Bone.h"
 #include "Handle.h"
+#include "Progress.h"
+#include "WeightSolver.h"
+#include "InfluenceTable.h"
+#include "Skinning.h"
+#include "VertexNormals.h"
 
 class Mesh {
 public:
-    inline Mesh () {}
+    inline Mesh () : skeletonStamp (0) {}
     inline Mesh (const std::vector<Vertex> & v) 
-    : vertices (v) {}
+    : vertices (v), skeletonStamp (0) {}
     inline Mesh (const std::vector<Vertex> & v,
                  const std::vector<Triangle> & t) 
-    : vertices (v), triangles (t)  { }
+    : vertices (v), triangles (t), skeletonStamp (0)  { }
+    //les poids suivent le mesh (export en arrière-plan cf MeshExporter) ; pas la pose liée ni les calculs du WeightSolver
     inline Mesh (const Mesh & mesh)
         : vertices (mesh.vertices), 
-    triangles (mesh.triangles), vertices_bones(mesh.vertices_bones), bones(mesh.bones) { }
+    triangles (mesh.triangles), vertices_bones(mesh.vertices_bones), bones(mesh.bones), influences(mesh.influences),
+    skeletonStamp (mesh.skeletonStamp) { }
+    //même chose que la copie : le mesh affecté perd sa pose liée et les calculs de son WeightSolver
+    inline Mesh & operator= (const Mesh & mesh) {
+        Mesh copy (mesh);
+        swap (copy);
+        return *this;
+    }
     
     inline virtual ~Mesh () {}
+    //échange complet (poids compris) sans recopie
+    inline void swap (Mesh & mesh) {
+        vertices.swap (mesh.vertices);
+        triangles.swap (mesh.triangles);
+        vertices_bones.swap (mesh.vertices_bones);
+        bones.swap (mesh.bones);
+        influences.swap (mesh.influences);
+        weightSolver.swap (mesh.weightSolver);
+        skinning.swap (mesh.skinning);
+        vertexNormals.swap (mesh.vertexNormals);
+        std::swap (skeletonStamp, mesh.skeletonStamp);
+    }
     inline std::vector<Vertex> & getVertices () { return vertices; }
     inline const std::vector<Vertex> & getVertices () const { return vertices; }
     inline std::vector<Triangle> & getTriangles () { return triangles; }
@@ -42,7 +68,31 @@ public:
     inline const std::vector<Vertex> & getBonesVertices() const { return vertices_bones; }
     inline void setBoneVertices(unsigned int i, Vertex vert) { vertices_bones[i] = vert; }
     inline void setMeshVertices(unsigned int i, Vertex vert) { vertices[i] = vert; }
-    inline void initWeights() { computeWeights(weights); }
+    inline InfluenceTable & getInfluences() { return influences; }
+    inline const InfluenceTable & getInfluences() const { return influences; }
+    //réglages de la résolution des poids (direct/itératif, cf WeightSolver)
+    inline WeightSolver & getWeightSolver() { return weightSolver; }
+    inline const WeightSolver & getWeightSolver() const { return weightSolver; }
+    //calcule les poids puis la table des K bones les plus influents de chaque vertex
+    //cached : relit/écrit la table dans le cache disque (cf WeightCache::shared)
+    void initWeights(Progress * progress = NULL, bool cached = true);
+    //aperçu immédiat en attendant la résolution (cf WeightWorker) : poids en 1/d^4 de la distance aux bones
+    void previewWeights();
+    //installe une nouvelle table (cf WeightWorker) : la pose de repos est à refaire, sauf pendant une pose où
+    //elle est gardée et la pose courante recalculée avec ces poids
+    void swapInfluences(InfluenceTable & table);
+    
+    //pose de repos (cf Skinning) : les vertices et le squelette actuels, avec les poids (calculés s'il le faut).
+    //sans effet si elle est déjà prise ; unbindPose l'oublie (squelette ou poids modifiés)
+    void bindPose();
+    void unbindPose();
+    inline const Skinning & getSkinning() const { return skinning; }
+    //LBS ou quaternions duaux (cf Skinning::Mode), gardé d'une pose de repos à l'autre
+    inline Skinning::Mode getSkinningMode() const { return skinning.getMode(); }
+    inline void setSkinningMode(Skinning::Mode m) { skinning.setMode(m); }
+    //recalcule les vertices depuis la pose de repos, pour le squelette courant ; les normales des vertices
+    //déplacés et de leur voisinage sont ensuite recalculées sur la surface déformée (cf VertexNormals)
+    void deform();
     
     void clear ();
     void clearGeometry ();
@@ -55,20 +105,33 @@ public:
     void computeDualEdgeMap (EdgeMapIndex & dualVMap1, EdgeMapIndex & dualVMap2);
     void markBorderEdges (EdgeMapIndex & edgeMap);
     
+    //affichage OpenGL : défini dans MeshGL.cpp (absent de la cible MeshBatch)
     void renderGL (bool boneVisu, bool area, bool flat, int idx_bones = -1) const;
     void makeCube (const Vec3Df & v0, const Vec3Df & v1, std::vector<Vec3Df> & vert, std::vector<Triangle> & tri) const;
     void drawSphere(unsigned int resU, unsigned int resV, Vec3Df pos) const;
     void drawBoundingBox(int idx_bone) const ;
     void centerToCandScaleToF(Vec3Df c, float f);
     
-    void modifyMesh(const int & idx_bone, const Vec3Df & x_displacement, const Vec3Df & y_displacement);
+    //end_displacement : met à jour la boîte englobante du bone (les poids sont à recalculer par l'appelant)
     void modifyBone(const int & idx_bone, const Vec3Df & x_displacement, const Vec3Df & y_displacement, bool end_displacement = 0);
-    void computeWeights(std::vector < Eigen::VectorXf> & w);
-    void addHandle(Vertex vert, bool influenceArea);
+    //progress (optionnel) : avancement (visibilité des bones, puis résolution cf WeightSolver::solve), et annulation
+    //depuis un autre thread à ces mêmes points
+    void computeWeights(std::vector < Eigen::VectorXf> & w, Progress * progress = NULL);
+    void addHandle(Vertex vert);
     void suppr(int idx_bone);
+    //version du squelette de repos : change à chaque bone ajouté, supprimé ou déplacé en mode Edit (cf editSkeleton),
+    //pour reconnaître des poids calculés pour un squelette précédent (cf WeightWorker::takeResult)
+    inline unsigned int getSkeletonStamp() const { return skeletonStamp; }
+    //le squelette de repos a été modifié : oublie la pose liée et change de version
+    void editSkeleton();
     
-    void loadOFF (const std::string & filename);
-    void loadOBJ (const std::string & filename);
+    //weldTolerance < 0 : pas de fusion des vertices confondus ; renvoient le nombre de vertices fusionnés
+    //nbThreads : threads de lecture d'un .obj (cf ObjParser), 0 pour un par coeur
+    unsigned int load (const std::string & filename, float weldTolerance = -1.f, unsigned int nbThreads = 0);
+    unsigned int loadOFF (const std::string & filename, float weldTolerance = -1.f);
+    unsigned int loadOBJ (const std::string & filename, float weldTolerance = -1.f, unsigned int nbThreads = 0);
+    unsigned int loadPLY (const std::string & filename, float weldTolerance = -1.f);
+    unsigned int weldVertices (float tolerance);
     void rotateAroundX(float angle);
     void rotateAroundY(float angle);
     void rotateAroundZ(float angle);
@@ -87,7 +150,11 @@ private:
     std::vector<Triangle> triangles;
     std::vector<Vertex> vertices_bones;
     std::vector<Armature * > bones; // car c'est une classe abstraite
-    std::vector <Eigen::VectorXf> weights;
+    InfluenceTable influences; // poids des bones, K par vertex (cf InfluenceTable)
+    WeightSolver weightSolver; // L et analyse symbolique (ou poids précédents) gardées tant que le mesh ne change pas
+    Skinning skinning; // pose de repos et transformations des bones (LBS)
+    VertexNormals vertexNormals; // adjacence vertex -> triangles et normales des triangles, construites avec la pose de repos
+    unsigned int skeletonStamp; // cf getSkeletonStamp
     
 };
 
@@ -0,0 +1,341 @@
+//
+//  MeshBatch.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 23/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+//outil en ligne de commande, sans Qt ni OpenGL : convertit tous les .off/.obj/.ply d'un dossier
+//en .meshbin, calcule les poids du skinning quand le modèle a des bones, et affiche le débit.
+//
+//  MeshBatch [-o dossier] [-j threads] [--weld tolérance] [--no-weights] [-q bits] [--solver mode] [--cache dossier|--no-cache]
+//            [--bake clip.bvh [--fps images] [--dqs]] [dossier|fichiers...]
+//
+//  -q bits : écrit aussi la version compressée .qmesh (positions sur bits bits par axe)
+//  --solver auto|direct|mg|cg|ic : résolution des poids (cf WeightSolver), auto par défaut
+//  --cache dossier : cache des poids (cf WeightCache), --no-cache : toujours refaire la résolution
+//  --bake clip.bvh : anime le squelette avec le clip (cf PoseTimeline) et écrit les positions de chaque image
+//                    dans un .pc2 (cf AnimationBaker), à --fps images par seconde (celles du clip par défaut),
+//                    en quaternions duaux avec --dqs
+
+#include "Mesh.h"
+#include "MeshBinary.h"
+#include "MeshCompressed.h"
+#include "WeightCache.h"
+#include "PoseTimeline.h"
+#include "AnimationBaker.h"
+#include "Threads.h"
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+struct BatchOptions {
+    BatchOptions () : nbThreads (0), threadsPerFile (1), weldTolerance (-1.f), withWeights (true), quantizationBits (0),
+        solverMode (WeightSolver::AUTO), preconditioner (WeightSolver::JACOBI), fps (0.f), dualQuaternion (false) {}
+    vector<string> inputs;
+    string outputDir;
+    unsigned int nbThreads;
+    unsigned int threadsPerFile;    // threads de lecture et de précalcul de chaque fichier
+    float weldTolerance;
+    bool withWeights;
+    unsigned int quantizationBits; // 0 : pas de .qmesh
+    WeightSolver::Mode solverMode;
+    WeightSolver::Preconditioner preconditioner;
+    string animation;               // .bvh à précalculer, vide : pas de .pc2
+    float fps;                      // 0 : celles du clip
+    bool dualQuaternion;
+};
+
+struct BatchResult {
+    BatchResult () : ok (false), bytes (0), compressedBytes (0), nbVertices (0), nbWelded (0), nbBones (0), nbFrames (0), loadTime (0), weightTime (0), saveTime (0), bakeTime (0) {}
+    bool ok;
+    string error;
+    unsigned long long bytes;
+    unsigned long long compressedBytes;
+    unsigned int nbVertices;
+    unsigned int nbWelded;      // vertices fusionnés à la lecture (--weld)
+    unsigned int nbBones;
+    unsigned int nbFrames;
+    double loadTime;
+    double weightTime;
+    double saveTime;
+    double bakeTime;
+};
+
+static inline double seconds (Clock::time_point t0, Clock::time_point t1) {
+    return chrono::duration<double> (t1 - t0).count ();
+}
+
+static string extension (const string & filename) {
+    size_t dot = filename.find_last_of ('.');
+    if (dot == string::npos)
+        return "";
+    string ext = filename.substr (dot + 1);
+    for (size_t i = 0; i < ext.size (); i++)
+        ext[i] = tolower (ext[i]);
+    return ext;
+}
+
+static inline bool isSource (const string & filename) {
+    string ext = extension (filename);
+    return ext == "off" || ext == "obj" || ext == "ply";
+}
+
+static string baseName (const string & filename) {
+    size_t slash = filename.find_last_of ('/');
+    return (slash == string::npos) ? filename : filename.substr (slash + 1);
+}
+
+static bool isDirectory (const string & path) {
+    struct stat st;
+    return stat (path.c_str (), &st) == 0 && S_ISDIR (st.st_mode);
+}
+
+static unsigned long long fileSize (const string & path) {
+    struct stat st;
+    return (stat (path.c_str (), &st) == 0) ? st.st_size : 0;
+}
+
+static void listSources (const string & dir, vector<string> & files) {
+    DIR * d = opendir (dir.c_str ());
+    if (d == NULL) {
+        fprintf (stderr, "Impossible d'ouvrir le dossier %s\n", dir.c_str ());
+        return;
+    }
+    vector<string> names;
+    while (struct dirent * entry = readdir (d))
+        if (entry->d_name[0] != '.' && isSource (entry->d_name))
+            names.push_back (entry->d_name);
+    closedir (d);
+    sort (names.begin (), names.end ());
+    for (size_t i = 0; i < names.size (); i++)
+        files.push_back (dir + "/" + names[i]);
+}
+
+static string outputName (const BatchOptions & options, const string & source, const string & extension = "meshbin") {
+    if (options.outputDir.empty ())
+        return source + "." + extension;
+    return options.outputDir + "/" + baseName (source) + "." + extension;
+}
+
+static void bakeAnimation (const BatchOptions & options, Mesh & mesh, const string & source, BatchResult & result) {
+    mesh.setSkinningMode (options.dualQuaternion ? Skinning::DUAL_QUATERNION : Skinning::LINEAR);
+    mesh.bindPose ();
+    PoseTimeline timeline;
+    timeline.loadBVH (options.animation, mesh.getBonesVertices (), mesh.getBones ());
+    float fps = (options.fps > 0) ? options.fps : 1.f / timeline.getFrameTime ();
+    result.nbFrames = (unsigned int) (timeline.getDuration () * fps + 0.5f) + 1;
+    AnimationBaker baker;
+    baker.setNbThreads (options.threadsPerFile);
+    baker.bake (mesh.getSkinning (), timeline, outputName (options, source, "pc2"), fps, result.nbFrames);
+}
+
+//le mesh ne libère pas ses bones : on les libère en quittant processFile, en cas d'erreur aussi
+struct BonesOwner {
+    BonesOwner (Mesh & mesh) : mesh (mesh) {}
+    ~BonesOwner () {
+        for (size_t i = 0; i < mesh.getBones ().size (); i++)
+            delete mesh.getBones ()[i];
+    }
+    Mesh & mesh;
+};
+
+static BatchResult processFile (const BatchOptions & options, const string & source) {
+    BatchResult result;
+    result.bytes = fileSize (source);
+    try {
+        Mesh mesh;
+        BonesOwner owner (mesh);
+        Clock::time_point t0 = Clock::now ();
+        result.nbWelded = mesh.load (source, options.weldTolerance, options.threadsPerFile);
+        Clock::time_point t1 = Clock::now ();
+        if (options.withWeights && !mesh.getBones ().empty () && !mesh.getVertices ().empty ()) {
+            mesh.getWeightSolver ().setMode (options.solverMode);
+            mesh.getWeightSolver ().setPreconditioner (options.preconditioner);
+            mesh.initWeights ();
+        }
+        Clock::time_point t2 = Clock::now ();
+        MeshBinary::save (mesh, outputName (options, source), options.withWeights, options.weldTolerance);
+        if (options.quantizationBits != 0) {
+            string compressed = outputName (options, source, "qmesh");
+            MeshCompressed::save (mesh, compressed, options.quantizationBits);
+            result.compressedBytes = fileSize (compressed);
+        }
+        Clock::time_point t3 = Clock::now ();
+        if (!options.animation.empty () && !mesh.getBones ().empty () && !mesh.getVertices ().empty ())
+            bakeAnimation (options, mesh, source, result);
+        Clock::time_point t4 = Clock::now ();
+
+        result.nbVertices = mesh.getVertices ().size ();
+        result.nbBones = mesh.getBones ().size ();
+        result.loadTime = seconds (t0, t1);
+        result.weightTime = seconds (t1, t2);
+        result.saveTime = seconds (t2, t3);
+        result.bakeTime = seconds (t3, t4);
+        result.ok = true;
+    } catch (const Mesh::Exception & e) {
+        result.error = e.getMessage ();
+    }
+    return result;
+}
+
+static void printResult (const string & source, const BatchResult & r) {
+    if (!r.ok) {
+        printf ("%-28s ERREUR : %s\n", baseName (source).c_str (), r.error.c_str ());
+        return;
+    }
+    double mbps = (r.loadTime > 0) ? r.bytes / (1024.0 * 1024.0) / r.loadTime : 0;
+    double vps = (r.loadTime > 0) ? r.nbVertices / r.loadTime : 0;
+    printf ("%-28s %9u vertices %4u bones | lecture %8.2f ms %9.1f MB/s %12.0f vertices/s | poids %9.2f ms | écriture %7.2f ms",
+            baseName (source).c_str (), r.nbVertices, r.nbBones,
+            1000 * r.loadTime, mbps, vps, 1000 * r.weightTime, 1000 * r.saveTime);
+    if (r.nbWelded != 0)
+        printf (" | %u vertices fusionnés", r.nbWelded);
+    if (r.compressedBytes != 0)
+        printf (" | qmesh %llu octets (%.1fx)", r.compressedBytes, double (r.bytes) / r.compressedBytes);
+    if (r.nbFrames != 0)
+        printf (" | animation %u images %8.2f ms (%.1f images/s)", r.nbFrames, 1000 * r.bakeTime, r.nbFrames / r.bakeTime);
+    printf ("\n");
+}
+
+static void usage (const char * program) {
+    fprintf (stderr, "usage : %s [-o dossier] [-j threads] [--weld tolérance] [--no-weights] [-q bits] [--solver auto|direct|mg|cg|ic] [--cache dossier|--no-cache] [--bake clip.bvh [--fps images] [--dqs]] [dossier|fichiers...]\n", program);
+}
+
+static bool parseArguments (int argc, char ** argv, BatchOptions & options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if ((arg == "-o" || arg == "-j" || arg == "--weld" || arg == "-q" || arg == "--solver" || arg == "--cache" || arg == "--bake" || arg == "--fps") && i + 1 >= argc)
+            return false;
+        if (arg == "-o")
+            options.outputDir = argv[++i];
+        else if (arg == "-j")
+            options.nbThreads = atoi (argv[++i]);
+        else if (arg == "--weld")
+            options.weldTolerance = atof (argv[++i]);
+        else if (arg == "-q") {
+            options.quantizationBits = atoi (argv[++i]);
+            if (options.quantizationBits < 1 || options.quantizationBits > MeshCompressed::MAX_BITS)
+                return false;
+        } else if (arg == "--solver") {
+            string mode = argv[++i];
+            if (mode == "auto")
+                options.solverMode = WeightSolver::AUTO;
+            else if (mode == "direct")
+                options.solverMode = WeightSolver::DIRECT;
+            else if (mode == "mg")
+                options.solverMode = WeightSolver::MULTIGRID;
+            else if (mode == "cg" || mode == "ic") {
+                options.solverMode = WeightSolver::ITERATIVE;
+                options.preconditioner = (mode == "ic") ? WeightSolver::INCOMPLETE_CHOLESKY : WeightSolver::JACOBI;
+            } else
+                return false;
+        } else if (arg == "--cache")
+            WeightCache::shared ().setDirectory (argv[++i]);
+        else if (arg == "--no-cache")
+            WeightCache::shared ().setEnabled (false);
+        else if (arg == "--bake")
+            options.animation = argv[++i];
+        else if (arg == "--fps") {
+            options.fps = atof (argv[++i]);
+            if (options.fps <= 0)
+                return false;
+        } else if (arg == "--dqs")
+            options.dualQuaternion = true;
+        else if (arg == "--no-weights")
+            options.withWeights = false;
+        else if (arg == "-h" || arg == "--help")
+            return false;
+        else if (!arg.empty () && arg[0] == '-')
+            return false;
+        else
+            options.inputs.push_back (arg);
+    }
+    if (options.inputs.empty ())
+        options.inputs.push_back ("models");
+    if (options.nbThreads == 0)
+        options.nbThreads = defaultNbThreads ();
+    return true;
+}
+
+int main (int argc, char ** argv) {
+    BatchOptions options;
+    if (!parseArguments (argc, argv, options)) {
+        usage (argv[0]);
+        return 1;
+    }
+    if (!options.outputDir.empty ())
+        mkdir (options.outputDir.c_str (), 0755);
+
+    vector<string> files;
+    for (size_t i = 0; i < options.inputs.size (); i++) {
+        if (isDirectory (options.inputs[i]))
+            listSources (options.inputs[i], files);
+        else
+            files.push_back (options.inputs[i]);
+    }
+    if (files.empty ()) {
+        fprintf (stderr, "Aucun fichier .off/.obj/.ply à convertir\n");
+        return 1;
+    }
+
+    //les coeurs sont partagés entre les fichiers traités en même temps : chacun lit et précalcule
+    //avec sa part des threads
+    unsigned int nbWorkers = min<size_t> (options.nbThreads, files.size ());
+    options.threadsPerFile = max (1u, defaultNbThreads () / nbWorkers);
+
+    //chaque thread prend le prochain fichier de la liste ; les résultats sont affichés au fil de l'eau
+    vector<BatchResult> results (files.size ());
+    atomic<size_t> next (0);
+    mutex outputMutex;
+    Clock::time_point start = Clock::now ();
+
+    auto worker = [&] () {
+        for (size_t i = next++; i < files.size (); i = next++) {
+            results[i] = processFile (options, files[i]);
+            lock_guard<mutex> lock (outputMutex);
+            printResult (files[i], results[i]);
+            fflush (stdout);
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned int i = 1; i < nbWorkers; i++)
+        workers.push_back (thread (worker));
+    worker ();
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+
+    double total = seconds (start, Clock::now ());
+    unsigned long long bytes = 0, nbVertices = 0;
+    unsigned int nbFailed = 0;
+    for (size_t i = 0; i < results.size (); i++) {
+        if (!results[i].ok) {
+            nbFailed++;
+            continue;
+        }
+        bytes += results[i].bytes;
+        nbVertices += results[i].nbVertices;
+    }
+    printf ("%u fichiers (%u erreurs) en %.2f ms avec %u threads : %.1f MB/s, %.0f vertices/s\n",
+            (unsigned int) files.size (), nbFailed, 1000 * total, nbWorkers,
+            bytes / (1024.0 * 1024.0) / total, nbVertices / total);
+
+    return nbFailed == 0 ? 0 : 2;
+}
@@ -0,0 +1,263 @@
+//
+//  MeshBinary.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 22/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MeshBinary.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const uint32_t ENDIANNESS = 0x01020304;
+
+static inline uint64_t align16 (uint64_t offset) {
+    return (offset + 15) & ~uint64_t (15);
+}
+
+//tailles en octets de chaque section, dans l'ordre de MeshBinary::Section
+static void sectionSizes (const MeshBinary::Header & header, uint64_t sizes[6]) {
+    sizes[MeshBinary::POSITIONS] = uint64_t (header.nbVertices) * 3 * sizeof (float);
+    sizes[MeshBinary::NORMALS] = uint64_t (header.nbVertices) * 3 * sizeof (float);
+    sizes[MeshBinary::TRIANGLES] = uint64_t (header.nbTriangles) * 3 * sizeof (uint32_t);
+    sizes[MeshBinary::BONE_VERTICES] = uint64_t (header.nbBoneVertices) * 3 * sizeof (float);
+    sizes[MeshBinary::BONES] = uint64_t (header.nbBones) * 3 * sizeof (uint32_t);
+    sizes[MeshBinary::WEIGHTS] = uint64_t (header.nbInfluences) * header.nbVertices * (sizeof (uint16_t) + sizeof (float));
+}
+
+void MeshBinary::save (const Mesh & mesh, const string & filename, bool withWeights, float weldTolerance) {
+    const vector<Vertex> & vertices = mesh.getVertices ();
+    const vector<Triangle> & triangles = mesh.getTriangles ();
+    const vector<Vertex> & vertices_bones = mesh.getBonesVertices ();
+    const vector<Armature *> & bones = mesh.getBones ();
+    const InfluenceTable & influences = mesh.getInfluences ();
+
+    Header header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "MESHBIN", 8);
+    header.version = VERSION;
+    header.endianness = ENDIANNESS;
+    header.nbVertices = vertices.size ();
+    header.nbTriangles = triangles.size ();
+    header.nbBoneVertices = vertices_bones.size ();
+    header.nbBones = bones.size ();
+    header.weldTolerance = weldTolerance;
+    //les poids ne sont gardés que s'ils correspondent au mesh et aux bones actuels
+    bool validWeights = withWeights && !influences.empty () && influences.getNbBones () == bones.size ()
+        && influences.getNbVertices () == vertices.size ();
+    header.nbInfluences = validWeights ? InfluenceTable::K : 0;
+
+    uint64_t sizes[6];
+    sectionSizes (header, sizes);
+    uint64_t offset = sizeof (Header);
+    for (unsigned int s = 0; s < 6; s++) {
+        header.offsets[s] = offset;
+        offset = align16 (offset + sizes[s]);
+    }
+    header.fileSize = offset;
+
+    //on remplit un seul buffer puis on l'écrit d'un coup
+    vector<char> buffer (header.fileSize, 0);
+    memcpy (buffer.data (), &header, sizeof (header));
+
+    float * positions = reinterpret_cast<float *> (buffer.data () + header.offsets[POSITIONS]);
+    float * normals = reinterpret_cast<float *> (buffer.data () + header.offsets[NORMALS]);
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        for (unsigned int j = 0; j < 3; j++) {
+            positions[3*i+j] = vertices[i].getPos ()[j];
+            normals[3*i+j] = vertices[i].getNormal ()[j];
+        }
+
+    uint32_t * indices = reinterpret_cast<uint32_t *> (buffer.data () + header.offsets[TRIANGLES]);
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            indices[3*i+j] = triangles[i].getVertex (j);
+
+    float * bonePositions = reinterpret_cast<float *> (buffer.data () + header.offsets[BONE_VERTICES]);
+    for (unsigned int i = 0; i < vertices_bones.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            bonePositions[3*i+j] = vertices_bones[i].getPos ()[j];
+
+    uint32_t * armatures = reinterpret_cast<uint32_t *> (buffer.data () + header.offsets[BONES]);
+    for (unsigned int i = 0; i < bones.size (); i++) {
+        if (bones[i]->getType () == "bone") {
+            armatures[3*i] = BONE;
+            armatures[3*i+1] = bones[i]->getVertex (0);
+            armatures[3*i+2] = bones[i]->getVertex (1);
+        } else {
+            armatures[3*i] = HANDLE;
+            armatures[3*i+1] = armatures[3*i+2] = bones[i]->getVertex (0);
+        }
+    }
+
+    uint16_t * influenceBones = reinterpret_cast<uint16_t *> (buffer.data () + header.offsets[WEIGHTS]);
+    float * w = reinterpret_cast<float *> (influenceBones + uint64_t (header.nbInfluences) * header.nbVertices);
+    for (unsigned int i = 0; header.nbInfluences != 0 && i < header.nbVertices; i++)
+        for (unsigned int k = 0; k < InfluenceTable::K; k++) {
+            influenceBones[InfluenceTable::K*i + k] = influences.getBone (i, k);
+            w[InfluenceTable::K*i + k] = influences.getWeight (i, k);
+        }
+
+    //écriture dans un fichier temporaire puis rename : un cache n'est jamais lu à moitié écrit
+    string tmpName = filename + ".tmp";
+    FILE * file = fopen (tmpName.c_str (), "wb");
+    if (file == NULL)
+        throw Mesh::Exception ("Failing opening the file " + tmpName + ".");
+    size_t written = fwrite (buffer.data (), 1, buffer.size (), file);
+    fclose (file);
+    if (written != buffer.size () || rename (tmpName.c_str (), filename.c_str ()) != 0) {
+        remove (tmpName.c_str ());
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+    }
+}
+
+void MeshBinary::load (Mesh & mesh, const string & filename) {
+    MappedFile file (filename);
+    if (!file.isOpen ())
+        throw Mesh::Exception ("Failing opening the file.");
+    if (file.size () < sizeof (Header))
+        throw Mesh::Exception ("Not a meshbin file.");
+
+    Header header;
+    memcpy (&header, file.data (), sizeof (Header));
+    if (memcmp (header.magic, "MESHBIN", 8) != 0)
+        throw Mesh::Exception ("Not a meshbin file.");
+    if (header.version != VERSION || header.endianness != ENDIANNESS)
+        throw Mesh::Exception ("Unsupported meshbin version.");
+
+    uint64_t sizes[6];
+    sectionSizes (header, sizes);
+    for (unsigned int s = 0; s < 6; s++)
+        if (header.offsets[s] % 16 != 0 || header.offsets[s] + sizes[s] > file.size ())
+            throw Mesh::Exception ("Truncated meshbin file.");
+
+    //les sections sont alignées dans le fichier projeté : on les lit directement
+    const float * positions = reinterpret_cast<const float *> (file.data () + header.offsets[POSITIONS]);
+    const float * normals = reinterpret_cast<const float *> (file.data () + header.offsets[NORMALS]);
+    const uint32_t * indices = reinterpret_cast<const uint32_t *> (file.data () + header.offsets[TRIANGLES]);
+    const float * bonePositions = reinterpret_cast<const float *> (file.data () + header.offsets[BONE_VERTICES]);
+    const uint32_t * armatures = reinterpret_cast<const uint32_t *> (file.data () + header.offsets[BONES]);
+    const uint16_t * influenceBones = reinterpret_cast<const uint16_t *> (file.data () + header.offsets[WEIGHTS]);
+    const float * w = reinterpret_cast<const float *> (influenceBones + uint64_t (header.nbInfluences) * header.nbVertices);
+
+    for (uint64_t i = 0; i < uint64_t (header.nbTriangles) * 3; i++)
+        if (indices[i] >= header.nbVertices)
+            throw Mesh::Exception ("Invalid meshbin triangle index.");
+    for (unsigned int i = 0; i < header.nbBones; i++)
+        if (armatures[3*i] > HANDLE || armatures[3*i+1] >= header.nbBoneVertices || armatures[3*i+2] >= header.nbBoneVertices)
+            throw Mesh::Exception ("Invalid meshbin bone.");
+    if (header.nbInfluences != 0 && header.nbInfluences != InfluenceTable::K)
+        throw Mesh::Exception ("Unsupported meshbin influences.");
+    for (uint64_t i = 0; i < uint64_t (header.nbInfluences) * header.nbVertices; i++)
+        if (influenceBones[i] >= header.nbBones && influenceBones[i] != InfluenceTable::NO_BONE)
+            throw Mesh::Exception ("Invalid meshbin influence.");
+
+    mesh.clear ();
+    vector<Vertex> & vertices = mesh.getVertices ();
+    vector<Triangle> & triangles = mesh.getTriangles ();
+    vector<Vertex> & vertices_bones = mesh.getBonesVertices ();
+    vector<Armature *> & bones = mesh.getBones ();
+    InfluenceTable & influences = mesh.getInfluences ();
+
+    vertices.reserve (header.nbVertices);
+    for (unsigned int i = 0; i < header.nbVertices; i++)
+        vertices.push_back (Vertex (Vec3Df (positions[3*i], positions[3*i+1], positions[3*i+2]),
+                                    Vec3Df (normals[3*i], normals[3*i+1], normals[3*i+2])));
+
+    triangles.reserve (header.nbTriangles);
+    for (unsigned int i = 0; i < header.nbTriangles; i++)
+        triangles.push_back (Triangle (indices + 3*i));
+
+    vertices_bones.reserve (header.nbBoneVertices);
+    for (unsigned int i = 0; i < header.nbBoneVertices; i++)
+        vertices_bones.push_back (Vertex (Vec3Df (bonePositions[3*i], bonePositions[3*i+1], bonePositions[3*i+2]),
+                                          Vec3Df (1.0, 0.0, 0.0)));
+
+    bones.reserve (header.nbBones);
+    for (unsigned int i = 0; i < header.nbBones; i++) {
+        if (armatures[3*i] == BONE) {
+            Bone * bone = new Bone (armatures[3*i+1], armatures[3*i+2]);
+            bone->buildBox (vertices_bones[armatures[3*i+1]], vertices_bones[armatures[3*i+2]]);
+            bones.push_back (bone);
+        } else {
+            Handle * handle = new Handle (armatures[3*i+1]);
+            handle->buildBox (vertices_bones[armatures[3*i+1]]);
+            bones.push_back (handle);
+        }
+    }
+
+    influences.clear ();
+    if (header.nbInfluences != 0)
+        influences.assign (header.nbVertices, header.nbBones, influenceBones, w);
+}
+
+bool MeshBinary::readHeader (const string & filename, Header & header) {
+    FILE * file = fopen (filename.c_str (), "rb");
+    if (file == NULL)
+        return false;
+    bool ok = fread (&header, sizeof (Header), 1, file) == 1;
+    fclose (file);
+    return ok && memcmp (header.magic, "MESHBIN", 8) == 0 && header.version == VERSION && header.endianness == ENDIANNESS;
+}
+
+static inline struct timespec modificationTime (const struct stat & st) {
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+bool MeshBinary::isNewer (const string & filename, const string & reference) {
+    struct stat st, stReference;
+    if (stat (filename.c_str (), &st) != 0)
+        return false;
+    if (stat (reference.c_str (), &stReference) != 0)
+        return true;
+    //à la nanoseconde et strictement : une source réécrite dans la même seconde que le cache le rend périmé
+    //(au pire, un système de fichiers grossier fait régénérer un cache encore bon)
+    struct timespec t = modificationTime (st), tReference = modificationTime (stReference);
+    return t.tv_sec > tReference.tv_sec || (t.tv_sec == tReference.tv_sec && t.tv_nsec > tReference.tv_nsec);
+}
+
+bool MeshBinary::hasValidCache (const string & source, float weldTolerance) {
+    string cache = cacheName (source);
+    Header header;
+    return isNewer (cache, source) && readHeader (cache, header) && header.weldTolerance == weldTolerance;
+}
+
+void MeshBinary::loadCached (Mesh & mesh, const string & source, float weldTolerance) {
+    //un .meshbin est lu tel quel (pas de cache du cache)
+    size_t dot = source.find_last_of ('.');
+    if (dot != string::npos && source.compare (dot, string::npos, ".meshbin") == 0) {
+        load (mesh, source);
+        return;
+    }
+    string cache = cacheName (source);
+    if (hasValidCache (source, weldTolerance)) {
+        try {
+            load (mesh, cache);
+            return;
+        } catch (const Mesh::Exception & e) {
+            //cache invalide (autre version, fichier tronqué...) : on le régénère
+            cout << e.getMessage () << endl;
+        }
+    }
+
+    mesh.load (source, weldTolerance);
+
+    try {
+        save (mesh, cache, true, weldTolerance);
+    } catch (const Mesh::Exception & e) {
+        //pas grave : on relira le fichier texte la prochaine fois
+        cout << e.getMessage () << endl;
+    }
+}
@@ -0,0 +1,59 @@
+//
+//  MeshBinary.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 22/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MeshBinary__
+#define __Projet__MeshBinary__
+
+#include <string>
+#include <stdint.h>
+
+class Mesh;
+
+class MeshBinary {
+    //format binaire .meshbin : positions, normales, triangles, vertices des bones, bones/handles
+    //et éventuellement la table des influences (cf InfluenceTable). Les tableaux sont stockés tels quels (alignés sur 16 octets),
+    //on les recopie depuis le fichier projeté en mémoire sans aucun parsing.
+public:
+    static const uint32_t VERSION = 3;
+
+    struct Header {
+        char magic[8];          // "MESHBIN"
+        uint32_t version;
+        uint32_t endianness;    // 0x01020304 écrit dans l'ordre de la machine
+        uint32_t nbVertices;
+        uint32_t nbTriangles;
+        uint32_t nbBoneVertices;
+        uint32_t nbBones;
+        uint32_t nbInfluences;  // influences par vertex : K bones (uint16) puis K poids (float), 0 si pas de poids
+        float weldTolerance;    // tolérance de fusion utilisée à la lecture du source (-1 : aucune)
+        uint64_t offsets[6];    // positions, normales, triangles, vertices des bones, bones, poids
+        uint64_t fileSize;
+        uint8_t padding[32];
+    };
+
+    enum Section { POSITIONS = 0, NORMALS, TRIANGLES, BONE_VERTICES, BONES, WEIGHTS };
+
+    //bone : (0, v0, v1), handle : (1, v, v)
+    enum ArmatureType { BONE = 0, HANDLE = 1 };
+
+    static void save (const Mesh & mesh, const std::string & filename, bool withWeights = true, float weldTolerance = -1.f);
+    static void load (Mesh & mesh, const std::string & filename);
+    static bool readHeader (const std::string & filename, Header & header);
+
+    //nom du cache associé à un fichier source : "models/bone.obj" -> "models/bone.obj.meshbin"
+    static inline std::string cacheName (const std::string & source) { return source + ".meshbin"; }
+    static bool isNewer (const std::string & filename, const std::string & reference);
+    //le cache existe, est plus récent que le source et a été créé avec la même tolérance de fusion
+    static bool hasValidCache (const std::string & source, float weldTolerance = -1.f);
+
+    //charge le cache s'il est plus récent que le source (et lu avec la même tolérance de fusion),
+    //sinon lit le source et (re)crée le cache. Un .meshbin passé en source est simplement lu.
+    static void loadCached (Mesh & mesh, const std::string & source, float weldTolerance = -1.f);
+};
+
+#endif /* defined(__Projet__MeshBinary__) */
@@ -0,0 +1,424 @@
+//
+//  MeshCompressed.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 27/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MeshCompressed.h"
+#include "MappedFile.h"
+#include "BoundingBox.h"
+#include "Mesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+static const uint32_t ENDIANNESS = 0x01020304;
+
+const uint32_t MeshCompressed::VERSION;
+const unsigned int MeshCompressed::DEFAULT_BITS;
+const unsigned int MeshCompressed::MAX_BITS;
+
+//entiers signés -> non signés : 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+static inline uint32_t zigzag (int32_t v) {
+    return (uint32_t (v) << 1) ^ uint32_t (v >> 31);
+}
+
+static inline int32_t unzigzag (uint32_t v) {
+    return int32_t (v >> 1) ^ -int32_t (v & 1);
+}
+
+static inline void writeVarint (vector<uint8_t> & out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back (uint8_t (v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back (uint8_t (v));
+}
+
+static inline uint32_t readVarint (const uint8_t * & p, const uint8_t * end) {
+    uint32_t v = 0;
+    for (unsigned int shift = 0; shift < 35; shift += 7) {
+        if (p >= end)
+            throw Mesh::Exception ("Truncated qmesh file.");
+        uint8_t byte = *p++;
+        v |= uint32_t (byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return v;
+    }
+    throw Mesh::Exception ("Invalid qmesh varint.");
+}
+
+//état commun au codeur et au décodeur des triangles : arêtes et vertices récents
+class TriangleCodec {
+public:
+    static const unsigned int NO_EDGE = 15;
+    static const unsigned int EXPLICIT = 15;
+
+    TriangleCodec () : edgeOffset (0), vertexOffset (0), next (0) {
+        memset (edges, 0xff, sizeof (edges));
+        memset (recent, 0xff, sizeof (recent));
+    }
+
+    void encode (const uint32_t v[3], vector<uint8_t> & out) {
+        for (unsigned int e = 0; e < NO_EDGE; e++) {
+            const uint32_t * edge = edges[(edgeOffset - 1 - e) & 15];
+            for (unsigned int r = 0; r < 3; r++) {
+                if (edge[0] != v[r] || edge[1] != v[(r+1)%3])
+                    continue;
+                uint32_t c = v[(r+2)%3];
+                unsigned int code = EXPLICIT;
+                if (c == next)
+                    code = 0;
+                else
+                    for (unsigned int k = 0; k < 14; k++)
+                        if (recent[(vertexOffset - 1 - k) & 15] == c) {
+                            code = k + 1;
+                            break;
+                        }
+                out.push_back (uint8_t ((e << 4) | code));
+                if (code == EXPLICIT)
+                    writeVarint (out, zigzag (int32_t (c - next)));
+                finish (edge[0], edge[1], c, code == 0 || code == EXPLICIT);
+                return;
+            }
+        }
+        out.push_back (uint8_t (NO_EDGE << 4));
+        for (unsigned int j = 0; j < 3; j++) {
+            writeVarint (out, zigzag (int32_t (v[j] - next)));
+            use (v[j]);
+        }
+        pushEdges (v[0], v[1], v[2]);
+    }
+
+    void decode (const uint8_t * & p, const uint8_t * end, uint32_t v[3]) {
+        if (p >= end)
+            throw Mesh::Exception ("Truncated qmesh file.");
+        uint8_t control = *p++;
+        unsigned int e = control >> 4, code = control & 15;
+        if (e == NO_EDGE) {
+            for (unsigned int j = 0; j < 3; j++) {
+                v[j] = next + unzigzag (readVarint (p, end));
+                use (v[j]);
+            }
+            pushEdges (v[0], v[1], v[2]);
+            return;
+        }
+        const uint32_t * edge = edges[(edgeOffset - 1 - e) & 15];
+        v[0] = edge[0];
+        v[1] = edge[1];
+        if (code == 0)
+            v[2] = next;
+        else if (code == EXPLICIT)
+            v[2] = next + unzigzag (readVarint (p, end));
+        else
+            v[2] = recent[(vertexOffset - code) & 15];
+        finish (v[0], v[1], v[2], code == 0 || code == EXPLICIT);
+    }
+
+private:
+    //un vertex lu explicitement rejoint les vertices récents ; next = plus grand index vu + 1
+    inline void use (uint32_t v) {
+        recent[vertexOffset++ & 15] = v;
+        if (v >= next)
+            next = v + 1;
+    }
+
+    //les voisins d'un triangle (a, b, c) contiennent ses arêtes dans l'autre sens
+    inline void pushEdges (uint32_t a, uint32_t b, uint32_t c) {
+        pushEdge (b, a);
+        pushEdge (c, b);
+        pushEdge (a, c);
+    }
+
+    inline void pushEdge (uint32_t a, uint32_t b) {
+        uint32_t * edge = edges[edgeOffset++ & 15];
+        edge[0] = a;
+        edge[1] = b;
+    }
+
+    //triangle (a, b, c) trouvé par son arête (a, b) : seules les deux autres arêtes sont nouvelles
+    inline void finish (uint32_t a, uint32_t b, uint32_t c, bool newVertex) {
+        if (newVertex)
+            use (c);
+        pushEdge (c, b);
+        pushEdge (a, c);
+    }
+
+    uint32_t edges[16][2];
+    uint32_t recent[16];
+    unsigned int edgeOffset, vertexOffset;
+    uint32_t next;
+};
+
+//parcours en profondeur des triangles par les vertices partagés : les triangles consécutifs sont voisins
+static vector<uint32_t> traversalOrder (const vector<Triangle> & triangles, unsigned int nbVertices) {
+    //triangles de chaque vertex, rangés à la suite (offsets[v] .. offsets[v+1])
+    vector<uint32_t> offsets (nbVertices + 1, 0);
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            offsets[triangles[i].getVertex (j) + 1]++;
+    for (unsigned int v = 0; v < nbVertices; v++)
+        offsets[v + 1] += offsets[v];
+    vector<uint32_t> adjacency (offsets[nbVertices]);
+    vector<uint32_t> fill (offsets.begin (), offsets.end () - 1);
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            adjacency[fill[triangles[i].getVertex (j)]++] = i;
+
+    vector<uint32_t> traversal;
+    traversal.reserve (triangles.size ());
+    vector<bool> visited (triangles.size (), false);
+    vector<uint32_t> stack;
+    for (unsigned int seed = 0; seed < triangles.size (); seed++) {
+        if (visited[seed])
+            continue;
+        stack.push_back (seed);
+        while (!stack.empty ()) {
+            uint32_t t = stack.back ();
+            stack.pop_back ();
+            if (visited[t])
+                continue;
+            visited[t] = true;
+            traversal.push_back (t);
+            //le premier vertex est empilé en dernier : ses voisins sortent en premier
+            for (int j = 2; j >= 0; j--) {
+                uint32_t v = triangles[t].getVertex (j);
+                for (uint32_t k = offsets[v]; k < offsets[v + 1]; k++)
+                    if (!visited[adjacency[k]])
+                        stack.push_back (adjacency[k]);
+            }
+        }
+    }
+    return traversal;
+}
+
+//positions et triangles, les triangles pris dans l'ordre "triangleOrder"
+static void encode (const vector<Vertex> & vertices, const vector<Triangle> & triangles, const vector<uint32_t> & triangleOrder,
+                    const MeshCompressed::Header & header, vector<uint8_t> & positions, vector<uint8_t> & indices) {
+    //nouvelle numérotation : ordre de première utilisation (les vertices non utilisés à la fin)
+    vector<uint32_t> order (vertices.size (), uint32_t (-1));
+    vector<uint32_t> sorted;
+    sorted.reserve (vertices.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++) {
+            uint32_t v = triangles[triangleOrder[i]].getVertex (j);
+            if (order[v] == uint32_t (-1)) {
+                order[v] = sorted.size ();
+                sorted.push_back (v);
+            }
+        }
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        if (order[i] == uint32_t (-1)) {
+            order[i] = sorted.size ();
+            sorted.push_back (i);
+        }
+
+    //positions quantifiées, en écart au vertex précédent (voisins dans l'ordre des triangles)
+    positions.reserve (vertices.size () * 3 * 2);
+    const uint32_t maxLevel = (1u << header.bits) - 1;
+    float scale[3];
+    for (unsigned int c = 0; c < 3; c++) {
+        float extent = header.max[c] - header.min[c];
+        scale[c] = (extent > 0) ? maxLevel / extent : 0.f;
+    }
+    int32_t previous[3] = {0, 0, 0};
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            float q = floor ((vertices[sorted[i]].getPos ()[c] - header.min[c]) * scale[c] + 0.5f);
+            int32_t level = int32_t (q < 0 ? 0 : (q > maxLevel ? maxLevel : q));
+            writeVarint (positions, zigzag (level - previous[c]));
+            previous[c] = level;
+        }
+
+    indices.reserve (triangles.size () * 2);
+    TriangleCodec codec;
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        uint32_t v[3];
+        for (unsigned int j = 0; j < 3; j++)
+            v[j] = order[triangles[triangleOrder[i]].getVertex (j)];
+        codec.encode (v, indices);
+    }
+}
+
+void MeshCompressed::save (const Mesh & mesh, const string & filename, unsigned int bits) {
+    if (bits < 1 || bits > MAX_BITS)
+        throw Mesh::Exception ("Invalid qmesh quantization.");
+    const vector<Vertex> & vertices = mesh.getVertices ();
+    const vector<Triangle> & triangles = mesh.getTriangles ();
+    const vector<Vertex> & vertices_bones = mesh.getBonesVertices ();
+    const vector<Armature *> & bones = mesh.getBones ();
+
+    Header header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "QMESH", 6);
+    header.version = VERSION;
+    header.endianness = ENDIANNESS;
+    header.bits = bits;
+    header.nbVertices = vertices.size ();
+    header.nbTriangles = triangles.size ();
+    header.nbBoneVertices = vertices_bones.size ();
+    header.nbBones = bones.size ();
+
+    BoundingBox box;
+    if (!vertices.empty ()) {
+        box = BoundingBox (vertices[0].getPos ());
+        for (unsigned int i = 1; i < vertices.size (); i++)
+            box.extendTo (vertices[i].getPos ());
+    }
+    for (unsigned int c = 0; c < 3; c++) {
+        header.min[c] = box.getMin ()[c];
+        header.max[c] = box.getMax ()[c];
+    }
+
+    //on code les triangles dans l'ordre du fichier et dans l'ordre d'un parcours du maillage
+    //(beaucoup de fichiers ont leurs faces dans le désordre), et on garde le plus compact
+    vector<uint32_t> fileOrder (triangles.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        fileOrder[i] = i;
+    vector<uint8_t> positions, indices;
+    encode (vertices, triangles, fileOrder, header, positions, indices);
+    vector<uint8_t> traversalPositions, traversalIndices;
+    encode (vertices, triangles, traversalOrder (triangles, vertices.size ()), header, traversalPositions, traversalIndices);
+    if (traversalPositions.size () + traversalIndices.size () < positions.size () + indices.size ()) {
+        positions.swap (traversalPositions);
+        indices.swap (traversalIndices);
+    }
+
+    vector<uint8_t> skeleton (vertices_bones.size () * 3 * sizeof (float));
+    for (unsigned int i = 0; i < vertices_bones.size (); i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            float f = vertices_bones[i].getPos ()[c];
+            memcpy (&skeleton[(3*i + c) * sizeof (float)], &f, sizeof (float));
+        }
+    //bone : (0, v0, v1), handle : (1, v)
+    for (unsigned int i = 0; i < bones.size (); i++) {
+        if (bones[i]->getType () == "bone") {
+            writeVarint (skeleton, 0);
+            writeVarint (skeleton, bones[i]->getVertex (0));
+            writeVarint (skeleton, bones[i]->getVertex (1));
+        } else {
+            writeVarint (skeleton, 1);
+            writeVarint (skeleton, bones[i]->getVertex (0));
+        }
+    }
+
+    header.positionsSize = positions.size ();
+    header.trianglesSize = indices.size ();
+    header.bonesSize = skeleton.size ();
+
+    string tmpName = filename + ".tmp";
+    FILE * file = fopen (tmpName.c_str (), "wb");
+    if (file == NULL)
+        throw Mesh::Exception ("Failing opening the file " + tmpName + ".");
+    bool ok = fwrite (&header, sizeof (header), 1, file) == 1
+        && fwrite (positions.data (), 1, positions.size (), file) == positions.size ()
+        && fwrite (indices.data (), 1, indices.size (), file) == indices.size ()
+        && fwrite (skeleton.data (), 1, skeleton.size (), file) == skeleton.size ();
+    fclose (file);
+    if (!ok || rename (tmpName.c_str (), filename.c_str ()) != 0) {
+        remove (tmpName.c_str ());
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+    }
+}
+
+void MeshCompressed::load (Mesh & mesh, const string & filename) {
+    MappedFile file (filename);
+    if (!file.isOpen ())
+        throw Mesh::Exception ("Failing opening the file.");
+    Header header;
+    if (file.size () < sizeof (Header))
+        throw Mesh::Exception ("Not a qmesh file.");
+    memcpy (&header, file.data (), sizeof (Header));
+    if (memcmp (header.magic, "QMESH", 6) != 0)
+        throw Mesh::Exception ("Not a qmesh file.");
+    if (header.version != VERSION || header.endianness != ENDIANNESS || header.bits < 1 || header.bits > MAX_BITS)
+        throw Mesh::Exception ("Unsupported qmesh version.");
+    //chaque taille est bornée par le fichier avant d'être additionnée (pas de débordement de la somme),
+    //et chaque compte par sa taille (au moins 1 octet par varint) avant de réserver quoi que ce soit
+    uint64_t available = file.size () - sizeof (Header);
+    if (header.positionsSize > available || header.trianglesSize > available || header.bonesSize > available
+        || header.positionsSize + header.trianglesSize + header.bonesSize > available)
+        throw Mesh::Exception ("Truncated qmesh file.");
+    if (uint64_t (header.nbVertices) * 3 > header.positionsSize
+        || uint64_t (header.nbTriangles) > header.trianglesSize
+        || uint64_t (header.nbBoneVertices) * 3 * sizeof (float) + uint64_t (header.nbBones) * 2 > header.bonesSize)
+        throw Mesh::Exception ("Truncated qmesh file.");
+
+    const uint8_t * p = reinterpret_cast<const uint8_t *> (file.data ()) + sizeof (Header);
+    const uint8_t * positionsEnd = p + header.positionsSize;
+    const uint8_t * indicesEnd = positionsEnd + header.trianglesSize;
+    const uint8_t * bonesEnd = indicesEnd + header.bonesSize;
+
+    mesh.clear ();
+    vector<Vertex> & vertices = mesh.getVertices ();
+    vector<Triangle> & triangles = mesh.getTriangles ();
+    vector<Vertex> & vertices_bones = mesh.getBonesVertices ();
+    vector<Armature *> & bones = mesh.getBones ();
+
+    const uint32_t maxLevel = (1u << header.bits) - 1;
+    float step[3];
+    for (unsigned int c = 0; c < 3; c++)
+        step[c] = (header.max[c] - header.min[c]) / maxLevel;
+    int32_t level[3] = {0, 0, 0};
+    vertices.reserve (header.nbVertices);
+    for (unsigned int i = 0; i < header.nbVertices; i++) {
+        Vec3Df pos;
+        for (unsigned int c = 0; c < 3; c++) {
+            level[c] += unzigzag (readVarint (p, positionsEnd));
+            pos[c] = header.min[c] + level[c] * step[c];
+        }
+        vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
+    }
+
+    p = positionsEnd;
+    triangles.reserve (header.nbTriangles);
+    TriangleCodec codec;
+    for (unsigned int i = 0; i < header.nbTriangles; i++) {
+        uint32_t v[3];
+        codec.decode (p, indicesEnd, v);
+        if (v[0] >= header.nbVertices || v[1] >= header.nbVertices || v[2] >= header.nbVertices)
+            throw Mesh::Exception ("Invalid qmesh triangle index.");
+        triangles.push_back (Triangle (v[0], v[1], v[2]));
+    }
+
+    p = indicesEnd;
+    vertices_bones.reserve (header.nbBoneVertices);
+    for (unsigned int i = 0; i < header.nbBoneVertices; i++, p += 3 * sizeof (float)) {
+        float pos[3];
+        memcpy (pos, p, sizeof (pos));
+        vertices_bones.push_back (Vertex (Vec3Df (pos[0], pos[1], pos[2]), Vec3Df (1.0, 0.0, 0.0)));
+    }
+    //on vérifie tous les bones avant d'en allouer un seul
+    vector<uint32_t> records (3 * size_t (header.nbBones));
+    for (unsigned int i = 0; i < header.nbBones; i++) {
+        uint32_t type = readVarint (p, bonesEnd);
+        uint32_t v0 = readVarint (p, bonesEnd);
+        uint32_t v1 = (type == 0) ? readVarint (p, bonesEnd) : v0;
+        if (type > 1 || v0 >= header.nbBoneVertices || v1 >= header.nbBoneVertices)
+            throw Mesh::Exception ("Invalid qmesh bone.");
+        records[3*i] = type;
+        records[3*i+1] = v0;
+        records[3*i+2] = v1;
+    }
+    bones.reserve (header.nbBones);
+    for (unsigned int i = 0; i < header.nbBones; i++) {
+        uint32_t type = records[3*i], v0 = records[3*i+1], v1 = records[3*i+2];
+        if (type == 0) {
+            Bone * bone = new Bone (v0, v1);
+            bone->buildBox (vertices_bones[v0], vertices_bones[v1]);
+            bones.push_back (bone);
+        } else {
+            Handle * handle = new Handle (v0);
+            handle->buildBox (vertices_bones[v0]);
+            bones.push_back (handle);
+        }
+    }
+
+    mesh.recomputeSmoothVertexNormals (0);
+}
@@ -0,0 +1,55 @@
+//
+//  MeshCompressed.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 27/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MeshCompressed__
+#define __Projet__MeshCompressed__
+
+#include <string>
+#include <stdint.h>
+
+class Mesh;
+
+class MeshCompressed {
+    //format compressé .qmesh, pour distribuer les modèles :
+    // - les triangles sont gardés dans l'ordre du fichier ou réordonnés par un parcours du maillage
+    //   (le plus compact des deux), et les vertices renumérotés dans l'ordre de leur première utilisation ;
+    // - positions quantifiées sur "bits" bits par axe dans la BoundingBox du mesh, puis codées
+    //   en écart au vertex précédent (zigzag + varint) ;
+    // - triangles : un octet de contrôle par triangle. Un triangle qui partage une arête avec un des
+    //   15 derniers triangles ne code que son troisième vertex : nouveau vertex, un des 14 derniers
+    //   vertices, ou écart en varint. Sinon les trois index sont codés en écart (varint) ;
+    // - squelette tel quel (positions en float), bones en varint.
+    //les normales sont recalculées à la lecture et les poids ne sont pas stockés. Les triangles
+    //peuvent revenir avec leurs sommets permutés circulairement (même orientation).
+public:
+    static const uint32_t VERSION = 1;
+    static const unsigned int DEFAULT_BITS = 16;
+    static const unsigned int MAX_BITS = 24;
+
+    struct Header {
+        char magic[8];          // "QMESH"
+        uint32_t version;
+        uint32_t endianness;    // 0x01020304 écrit dans l'ordre de la machine
+        uint32_t bits;          // bits par axe pour les positions
+        uint32_t nbVertices;
+        uint32_t nbTriangles;
+        uint32_t nbBoneVertices;
+        uint32_t nbBones;
+        float min[3];           // BoundingBox des vertices du mesh
+        float max[3];
+        uint32_t padding;
+        uint64_t positionsSize; // taille en octets de chaque flux, dans l'ordre du fichier
+        uint64_t trianglesSize;
+        uint64_t bonesSize;
+    };
+
+    static void save (const Mesh & mesh, const std::string & filename, unsigned int bits = DEFAULT_BITS);
+    static void load (Mesh & mesh, const std::string & filename);
+};
+
+#endif /* defined(__Projet__MeshCompressed__) */
@@ -0,0 +1,203 @@
+//
+//  MeshExporter.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 23/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MeshExporter.h"
+#include "MeshBinary.h"
+#include "MeshPLY.h"
+#include "MeshCompressed.h"
+#include "Mesh.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+class BufferedWriter {
+    //on accumule dans un buffer et on écrit par blocs
+public:
+    BufferedWriter (FILE * f) : file (f), buffer (CAPACITY), size (0), failed (false) {}
+
+    inline void write (const char * s, size_t n) {
+        if (size + n > CAPACITY)
+            flush ();
+        if (n > CAPACITY) {
+            if (fwrite (s, 1, n, file) != n)
+                failed = true;
+            return;
+        }
+        memcpy (&buffer[size], s, n);
+        size += n;
+    }
+    inline void write (const char * s) { write (s, strlen (s)); }
+    inline void write (char c) {
+        if (size + 1 > CAPACITY)
+            flush ();
+        buffer[size++] = c;
+    }
+    inline void write (unsigned long long v) {
+        char digits[24];
+        int n = 0;
+        do {
+            digits[n++] = char ('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        if (size + n > CAPACITY)
+            flush ();
+        while (n > 0)
+            buffer[size++] = digits[--n];
+    }
+    inline void write (float f) {
+        char digits[32];
+        write (digits, MeshExporter::formatFloat (f, digits));
+    }
+    void flush () {
+        if (size != 0 && fwrite (&buffer[0], 1, size, file) != size)
+            failed = true;
+        size = 0;
+    }
+    inline bool hasFailed () const { return failed; }
+
+private:
+    static const size_t CAPACITY = 1 << 20;
+    FILE * file;
+    vector<char> buffer;
+    size_t size;
+    bool failed;
+};
+
+int MeshExporter::formatFloat (float f, char * buffer) {
+    //on essaie les précisions croissantes : 9 chiffres significatifs suffisent toujours pour un float
+    for (int precision = 6; precision < 9; precision++) {
+        int n = snprintf (buffer, 32, "%.*g", precision, f);
+        if (strtof (buffer, NULL) == f)
+            return n;
+    }
+    return snprintf (buffer, 32, "%.9g", f);
+}
+
+static inline void writePosition (BufferedWriter & out, const Vec3Df & p) {
+    out.write ("v ", 2);
+    out.write (p[0]);
+    out.write (' ');
+    out.write (p[1]);
+    out.write (' ');
+    out.write (p[2]);
+    out.write ('\n');
+}
+
+void MeshExporter::exportOBJ (const Mesh & mesh, const string & filename) {
+    //écriture dans un fichier temporaire puis rename : le fichier final n'est jamais à moitié écrit
+    string tmpName = filename + ".tmp";
+    FILE * file = fopen (tmpName.c_str (), "wb");
+    if (file == NULL)
+        throw Mesh::Exception ("Failing opening the file " + tmpName + ".");
+
+    const vector<Vertex> & vertices = mesh.getVertices ();
+    const vector<Triangle> & triangles = mesh.getTriangles ();
+    const vector<Vertex> & bones_vertices = mesh.getBonesVertices ();
+    const vector<Armature *> & armatures = mesh.getBones ();
+
+    BufferedWriter out (file);
+
+    //on enregistre d'abord l'objet
+    out.write ("o face\n");
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        writePosition (out, vertices[i].getPos ());
+
+    //les faces (index à partir de 1 dans un .obj)
+    for (unsigned int i = 0; i < triangles.size (); i++) {
+        out.write ("f ", 2);
+        out.write ((unsigned long long) triangles[i].getVertex (0) + 1);
+        out.write (' ');
+        out.write ((unsigned long long) triangles[i].getVertex (1) + 1);
+        out.write (' ');
+        out.write ((unsigned long long) triangles[i].getVertex (2) + 1);
+        out.write ('\n');
+    }
+
+    //puis les bones
+    out.write ("s bone\n");
+    for (unsigned int i = 0; i < bones_vertices.size (); i++)
+        writePosition (out, bones_vertices[i].getPos ());
+
+    //les index des vertices des bones commencent à partir de la fin des index des vertices du mesh !
+    unsigned long long offset = vertices.size () + 1;
+    for (unsigned int i = 0; i < armatures.size (); i++) {
+        if (armatures[i]->getType () == "bone") {
+            // alors il s'agit d'un bone et on trace une ligne -> "l"
+            out.write ("l ", 2);
+            out.write (armatures[i]->getVertex (0) + offset);
+            out.write (' ');
+            out.write (armatures[i]->getVertex (1) + offset);
+            out.write ('\n');
+        } else if (armatures[i]->getType () == "handle") {
+            //alors il s'agit d'un handle, donc d'un unique point
+            out.write ("lv ", 3);
+            out.write (armatures[i]->getVertex (0) + offset);
+            out.write ('\n');
+        }
+    }
+    out.flush ();
+
+    if (fclose (file) != 0 || out.hasFailed () || rename (tmpName.c_str (), filename.c_str ()) != 0) {
+        remove (tmpName.c_str ());
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+    }
+}
+
+void MeshExporter::exportBinary (const Mesh & mesh, const string & filename) {
+    MeshBinary::save (mesh, filename);
+}
+
+void MeshExporter::exportPLY (const Mesh & mesh, const string & filename) {
+    MeshPLY::save (mesh, filename);
+}
+
+void MeshExporter::exportCompressed (const Mesh & mesh, const string & filename, unsigned int bits) {
+    MeshCompressed::save (mesh, filename, bits);
+}
+
+void MeshExporter::exportMesh (const Mesh & mesh, const string & filename) {
+    string extension = filename.substr (filename.find_last_of ('.') + 1);
+    if (extension == "meshbin")
+        exportBinary (mesh, filename);
+    else if (extension == "ply")
+        exportPLY (mesh, filename);
+    else if (extension == "qmesh")
+        exportCompressed (mesh, filename);
+    else
+        exportOBJ (mesh, filename);
+}
+
+//le thread possède sa copie du mesh et la détruit à la fin
+static void exportSnapshot (Mesh * snapshot, string filename) {
+    try {
+        MeshExporter::exportMesh (*snapshot, filename);
+        cout << "mesh enregistré dans " << filename << endl;
+    } catch (const Mesh::Exception & e) {
+        cout << e.getMessage () << endl;
+    }
+    vector<Armature *> & bones = snapshot->getBones ();
+    for (unsigned int i = 0; i < bones.size (); i++)
+        delete bones[i];
+    delete snapshot;
+}
+
+void MeshExporter::exportInBackground (const Mesh & mesh, const string & filename) {
+    //copie profonde : les bones du mesh peuvent être supprimés (suppr) pendant l'écriture
+    Mesh * snapshot = new Mesh (mesh);
+    vector<Armature *> & bones = snapshot->getBones ();
+    for (unsigned int i = 0; i < bones.size (); i++)
+        bones[i] = bones[i]->clone ();
+
+    thread worker (exportSnapshot, snapshot, filename);
+    worker.detach ();
+}
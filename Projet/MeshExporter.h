@@ -0,0 +1,40 @@
+//
+//  MeshExporter.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 23/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MeshExporter__
+#define __Projet__MeshExporter__
+
+#include <string>
+
+class Mesh;
+
+class MeshExporter {
+    //enregistrement du mesh et des bones, sans Qt : on écrit dans un gros buffer
+    //(pas de flush à chaque ligne) à partir de références const sur le mesh.
+public:
+    //.obj : d'abord l'objet ("o face"), puis le squelette ("s bone") dont les index
+    //commencent après les vertices du mesh
+    static void exportOBJ (const Mesh & mesh, const std::string & filename);
+    //même contenu en binaire (.meshbin, cf MeshBinary)
+    static void exportBinary (const Mesh & mesh, const std::string & filename);
+    //.ply binaire (cf MeshPLY) : le mesh seul, sans le squelette
+    static void exportPLY (const Mesh & mesh, const std::string & filename);
+    //.qmesh compressé (cf MeshCompressed), positions quantifiées sur bits bits par axe
+    static void exportCompressed (const Mesh & mesh, const std::string & filename, unsigned int bits = 16);
+    //choix selon l'extension
+    static void exportMesh (const Mesh & mesh, const std::string & filename);
+
+    //enregistrement dans un thread à part : on travaille sur une copie du mesh (bones compris)
+    //pour que l'interface puisse continuer à modifier le mesh pendant l'écriture
+    static void exportInBackground (const Mesh & mesh, const std::string & filename);
+
+    //écrit le plus court décimal qui redonne exactement f une fois relu, renvoie le nombre de caractères
+    static int formatFloat (float f, char * buffer);
+};
+
+#endif /* defined(__Projet__MeshExporter__) */
@@ -0,0 +1,318 @@
+// ---------------------------------------------------------
+// Mesh Class : OpenGL rendering
+// Author : Tamy Boubekeur (boubek@gmail.com).
+// Copyright (C) 2008 Tamy Boubekeur.
+// All rights reserved.
+// ---------------------------------------------------------
+
+//affichage OpenGL du mesh et des bones, séparé de Mesh.cpp pour que le coeur
+//(chargement, poids, export) puisse être compilé sans OpenGL (cf MeshBatch)
+
+#include "Mesh.h"
+#include <OpenGL/gl.h>
+
+using namespace std;
+
+inline void glVertexVec3Df (const Vec3Df & v) {
+    glVertex3f (v[0], v[1], v[2]);
+}
+
+inline void glNormalVec3Df (const Vec3Df & n) {
+    glNormal3f (n[0], n[1], n[2]);
+}
+ 
+inline void glDrawPoint (const Vec3Df & pos, const Vec3Df & normal) {
+    glNormalVec3Df (normal);
+    glVertexVec3Df (pos);
+}
+
+inline void glDrawPoint (const Vertex & v) { 
+    glDrawPoint (v.getPos (), v.getNormal ()); 
+}
+
+void Mesh::renderGL (bool boneVisu, bool area, bool flat, int idx_bone) const {
+    
+    glColor3ub(232, 183, 155);
+    //glLoadName(7); plus besoin car je n'utilise plus le picking d'openGL.
+    
+    //si on est en area et qu'on a sélectionné un bone, alors on monte sa zone d'influence !
+    //seulement si on voit les bones !
+    if (boneVisu && area && idx_bone != -1){
+        
+        glBegin(GL_TRIANGLES);
+        
+        for (unsigned int i = 0; i<triangles.size(); i++){
+            const Triangle & t = triangles[i];
+            Vertex v[3];
+            for (unsigned int j = 0; j < 3; j++)
+                v[j] = vertices[t.getVertex(j)];
+            if (flat) {
+                Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
+                                                      v[2].getPos () - v[0].getPos ());
+                normal.normalize ();
+                glNormalVec3Df (normal);
+            }
+            for (unsigned int j = 0; j < 3; j++){
+                if (influences.getBoneWeight(t.getVertex(j), idx_bone) >0){
+                    glColor3f(1.0, 0.0, 0.0);
+                }else{
+                    glColor3ub(232, 183, 155);
+                }
+                if (!flat)
+                    glDrawPoint (v[j]);
+                else
+                    glVertexVec3Df (v[j].getPos ());
+            }
+                
+        }
+        glEnd ();
+
+        
+    }else{
+        //on ne montre pas la zone d'influence des bones, donc on affiche le mesh classique
+        glBegin (GL_TRIANGLES);
+        for (unsigned int i = 0; i < triangles.size (); i++) {
+            const Triangle & t = triangles[i];
+            Vertex v[3];
+            for (unsigned int j = 0; j < 3; j++)
+                v[j] = vertices[t.getVertex(j)];
+            if (flat) {
+                Vec3Df normal = Vec3Df::crossProduct (v[1].getPos () - v[0].getPos (),
+                                                      v[2].getPos () - v[0].getPos ());
+                normal.normalize ();
+                glNormalVec3Df (normal);
+            }
+            for (unsigned int j = 0; j < 3; j++)
+                if (!flat)
+                    glDrawPoint (v[j]);
+                else
+                    glVertexVec3Df (v[j].getPos ());
+        }
+        glEnd ();
+    }
+    
+    //seulement si on veut voir les bones !
+    if (boneVisu){
+        
+        //dessiner le skelette
+        glColor3f(0.0, 0.0, 1.0);
+        glLineWidth(2);
+        glBegin (GL_LINES);
+        
+        for (unsigned int i=0; i< bones.size(); i++){
+            //on dessine seulement les bones non sélectionnés
+            if (i != idx_bone){
+                Armature* b = bones[i];
+                //on dessine une ligne seulement si c'est un bone !
+                if (b->getType() == "bone"){
+                    Vertex v[2];
+                    for (unsigned int j=0; j<2; j++)
+                        v[j] = vertices_bones[b->getVertex(j)];
+                    
+                    for (unsigned int j=0; j<2; j++){
+                        glVertexVec3Df (v[j].getPos ());
+                    }
+                }
+            }
+            
+        }
+        glEnd();
+        
+        for (unsigned int i =0; i<bones.size(); i++){
+            if (i != idx_bone){
+                
+                Armature * h = bones[i];
+                //on dessine le point seulement si c'est une handle
+                if (h->getType() == "handle"){
+                    Vertex v = vertices_bones[h->getVertex()];
+                    this->drawSphere(5, 5, v.getPos());
+                }
+            }
+        }
+        
+        // si idx_bone !=-1, on a sélectionné un bone et on le colorie d'une couleur différente
+        if(idx_bone != -1){
+            
+            if (bones[idx_bone]->getType() == "bone"){
+                //c'est un bone donc une ligne
+                glColor3f(1., 0., 0.);
+                glLineWidth(2);
+                glBegin (GL_LINES);
+                
+                Vertex v[2];
+                for (unsigned int j=0; j<2; j++)
+                    v[j] = vertices_bones[bones[idx_bone]->getVertex(j)];
+                
+                for (unsigned int j=0; j<2; j++){
+                    glVertexVec3Df (v[j].getPos ());
+                }
+                glEnd();
+                
+            }else{
+                //c'est un handle donc un point
+                glColor3f(1., 0., 0.);
+                Vertex v = vertices_bones[bones[idx_bone]->getVertex()];
+                this->drawSphere(5, 5, v.getPos());
+                
+            }
+        }
+
+    }
+        
+}
+
+void Mesh::drawSphere(unsigned int resU, unsigned int resV, Vec3Df pos) const{
+    
+    std::vector<Vertex> V(resU * (resV-2) + 2);
+    std::vector<Triangle> T(resU * (resV-2)*2 + 2*resU);
+    
+    // resU pas en theta
+    // resV pas en phi
+    int count = 0;
+    float x,y,z,theta,phi;
+    // en coordonnées sphériques, avec r = 1;
+    // on ajoute à la main le pole nord
+    V[count].setPos(Vec3Df(0,1,0));
+    count++;
+    for(unsigned int i = 0; i < resU; i++)
+    {
+        theta = 2*M_PI*i/resU;
+        //cout << "theta = " << theta << endl;
+        for(unsigned int j = 1 ; j < (resV-1) ; j++)
+        {
+            phi = M_PI*j/(resV-1);
+            //cout << "Phi " << phi << endl;
+            x = sin(phi)*sin(theta);
+            y = cos(phi);
+            z = sin(phi)*cos(theta);
+            
+            V[count].setPos(Vec3Df(x,y,z));
+            count ++;
+        }
+    }
+    // on ajoute à la main le pole sud
+    int max = count;
+    V[count].setPos(Vec3Df(0,-1,0));
+    
+    //construction voisinnage pole nord
+    count = 0;
+    for (unsigned int i = 0; i < resU; i++)
+    {
+        T[i].setVertex(0, 0 %(resU*(resV-2)));
+        T[i].setVertex(1, (count + 1)%(resU*(resV-2)));
+        T[i].setVertex(2, (count + 1 + resV-2)%(resU*(resV-2)));
+        
+        count += resV-2;
+    }
+    
+    //on décompose les quadrilatere logiquement obtenu par la construction des points de la sphere
+    // en 2 triangles.
+    for(unsigned int j = 0 ; j < resU ; j++)//resU ppour valeur finale j
+    {
+        for (unsigned int i = 1; i < resV-2; i++)
+        {
+            if(j != resU-1){
+                //premier triangle du carré
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)));
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2)+ 1));
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(2, ( i + j*(resV-2)+ 1 + resV-2));
+                
+                //2eme triangle du carré
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)+ 1+ (resV-2)));
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2) + (resV-2)));
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(2, (i + j*(resV-2)));
+                
+            }
+            //On fait attention au raccordement entre derniers indices et premiers indices
+            else{
+                //premier triangle du carré
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(0, (i + j*(resV-2)));
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(1, (i + j*(resV-2)+ 1));
+                T[2*(i-1)+2*j*(resV-3)+resU].setVertex(2, ( i +1));
+                
+                //2eme triangle du carré
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(0, ( i +1));
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(1, i);
+                T[2*(i-1)+1+2*j*(resV-3)+resU].setVertex(2, (i + j*(resV-2)));
+                
+            }
+        }
+    }
+    
+    //construction voisinnage pole sud
+    count = 0;
+    for (unsigned int i = T.size()-resU; i < T.size(); i++)
+    {
+        T[i].setVertex(0, max);
+        T[i].setVertex(1, (count + resV-2)%(resU*(resV-2)) + resV-2);
+        T[i].setVertex(2, (count)%(resU*(resV-2)) + resV-2);
+        
+        count += resV-2;
+    }
+    
+    Mesh mesh = Mesh(V, T);
+    mesh.recomputeSmoothVertexNormals(0);
+    mesh.centerToCandScaleToF(pos, 0.3);
+    
+    //je dessine ensuite ces vertices et triangles
+    //glTranslatef(pos[0], pos[1], pos[2]);
+    glBegin (GL_TRIANGLES);
+    for (unsigned int i = 0; i < mesh.getTriangles().size(); i++) {
+        const Triangle & t = mesh.getTriangles()[i];
+        Vertex v[3];
+        for (unsigned int j = 0; j < 3; j++)
+            v[j] = mesh.getVertices()[t.getVertex(j)];
+        for (unsigned int j = 0; j < 3; j++)
+            glDrawPoint (v[j]);
+    }
+    glEnd ();
+    
+}
+
+//méthode d'affichage des handles autre que les sphères (non utilisé ici)
+void Mesh::drawBoundingBox(int idx_bone) const {
+    BoundingBox box = bones[idx_bone]->getBoundingBox();
+    Vec3Df center = box.getCenter();
+  
+    Vec3Df min = box.getMin();
+    Vec3Df max = box.getMax();
+    Vec3Df v2(min[0] + box.getLength(), min[1], min[2]);
+    Vec3Df v3(min[0] + box.getLength(), min[1] + box.getHeight(), min[2]);
+    Vec3Df v4(min[0], min[1] + box.getLength(), min[2]);
+    Vec3Df v5(max[0] - box.getLength(), max[1] - box.getHeight(), max[2]);
+    Vec3Df v6(max[0], max[1] - box.getHeight(), max[2]);
+    Vec3Df v7(max[0] - box.getLength(), max[1], max[2]);
+    
+    glBegin(GL_QUADS);
+        glDrawPoint (min);
+        glDrawPoint (v2);
+        glDrawPoint (v3);
+        glDrawPoint (v4);
+    
+        glDrawPoint (max);
+        glDrawPoint (v7);
+        glDrawPoint (v4);
+        glDrawPoint (v3);
+    
+        glDrawPoint (max);
+        glDrawPoint (v3);
+        glDrawPoint (v2);
+        glDrawPoint (v6);
+    
+        glDrawPoint (v7);
+        glDrawPoint (max);
+        glDrawPoint (v6);
+        glDrawPoint (v5);
+    
+        glDrawPoint (v2);
+        glDrawPoint (min);
+        glDrawPoint (v5);
+        glDrawPoint (v6);
+    
+        glDrawPoint (v4);
+        glDrawPoint (v7);
+        glDrawPoint (v5);
+        glDrawPoint (min);
+    
+    glEnd();
+}
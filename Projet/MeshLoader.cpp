@@ -0,0 +1,177 @@
+//
+//  MeshLoader.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 25/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MeshLoader.h"
+#include "MeshBinary.h"
+#include "OffReader.h"
+
+#include <thread>
+#include <iostream>
+
+using namespace std;
+
+const unsigned int MeshLoader::PREVIEW_FACES;
+const unsigned int MeshLoader::REFINE_FACTOR;
+
+void MeshLoader::deleteBones (Object & object) {
+    vector<Armature *> & bones = object.getMesh ().getBones ();
+    for (unsigned int i = 0; i < bones.size (); i++)
+        delete bones[i];
+    bones.clear ();
+}
+
+void MeshLoader::publishPreview (Job & job, const vector<Vertex> & vertices, const vector<Triangle> & sample) {
+    //on ne garde que les vertices utilisés par l'échantillon
+    vector<int> index (vertices.size (), -1);
+    vector<Vertex> previewVertices;
+    vector<Triangle> previewTriangles;
+    previewTriangles.reserve (sample.size ());
+    for (unsigned int i = 0; i < sample.size (); i++) {
+        unsigned int v[3];
+        for (unsigned int j = 0; j < 3; j++) {
+            unsigned int k = sample[i].getVertex (j);
+            if (index[k] < 0) {
+                index[k] = previewVertices.size ();
+                previewVertices.push_back (vertices[k]);
+            }
+            v[j] = index[k];
+        }
+        previewTriangles.push_back (Triangle (v[0], v[1], v[2]));
+    }
+    Mesh mesh (previewVertices, previewTriangles);
+    mesh.recomputeSmoothVertexNormals (0);
+    Object object (mesh);
+
+    lock_guard<mutex> lock (job.previewMutex);
+    job.preview.swap (object);
+    job.hasPreview = true;
+}
+
+bool MeshLoader::streamOFF (Job & job, Mesh & mesh) {
+    OffReader reader;
+    reader.open (job.filename);
+    unsigned int nbFaces = reader.getNbFaces ();
+    if (nbFaces < 4 * PREVIEW_FACES)
+        return false;
+
+    job.progress.set ("Lecture des vertices", 0.f);
+    vector<Vertex> vertices;
+    reader.readVertices (vertices);
+
+    //aperçus de plus en plus fins, tant qu'ils restent nettement plus petits que le mesh complet
+    for (unsigned int n = PREVIEW_FACES; 2 * n < nbFaces; n *= REFINE_FACTOR) {
+        job.progress.set ("Aperçu", float (n) / nbFaces);
+        vector<Triangle> sample;
+        reader.sampleFaces (n, sample);
+        publishPreview (job, vertices, sample);
+    }
+
+    job.progress.set ("Lecture des faces", 1.f);
+    vector<Triangle> triangles;
+    reader.readFaces (triangles);
+    mesh.getVertices ().swap (vertices);
+    mesh.getTriangles ().swap (triangles);
+    mesh.recomputeSmoothVertexNormals (0);
+    try {
+        MeshBinary::save (mesh, MeshBinary::cacheName (job.filename));
+    } catch (const Mesh::Exception & e) {
+        cout << e.getMessage () << endl;
+    }
+    return true;
+}
+
+void MeshLoader::run (shared_ptr<Job> job) {
+    try {
+        size_t slash = job->filename.find_last_of ('/');
+        string name = (slash == string::npos) ? job->filename : job->filename.substr (slash + 1);
+        job->progress.set ("Lecture de " + name, 0.f);
+        Mesh mesh;
+        string extension = job->filename.substr (job->filename.find_last_of ('.') + 1);
+        bool streamed = (extension == "off" && !MeshBinary::hasValidCache (job->filename)
+                         && streamOFF (*job, mesh));
+        if (!streamed)
+            MeshBinary::loadCached (mesh, job->filename);
+        job->progress.set ("Lecture de " + name, 1.f);
+        job->object = Object (mesh);
+        if (job->withWeights)
+            job->object.getMesh ().initWeights (&job->progress);
+        //si l'interface a annulé entre temps, personne ne récupérera l'objet : on le libère ici
+        int expected = Running;
+        if (!job->state.compare_exchange_strong (expected, int (Finished)))
+            deleteBones (job->object);
+    } catch (const Progress::Cancelled &) {
+        deleteBones (job->object);
+        job->state = Cancelled;
+    } catch (const Mesh::Exception & e) {
+        deleteBones (job->object);
+        job->error = e.getMessage ();
+        job->state = Failed;
+    }
+}
+
+void MeshLoader::start (const string & name, bool withWeights) {
+    cancel ();
+    filename = name;
+    job = make_shared<Job> ();
+    job->filename = name;
+    job->withWeights = withWeights;
+    thread worker (run, job);
+    worker.detach ();
+}
+
+void MeshLoader::cancel () {
+    if (!job)
+        return;
+    job->progress.cancel ();
+    //un objet déjà chargé mais pas récupéré est libéré ici, sinon c'est le thread qui s'en charge
+    int expected = Running;
+    if (!job->state.compare_exchange_strong (expected, int (Cancelled)) && expected == Finished)
+        deleteBones (job->object);
+    job.reset ();
+}
+
+MeshLoader::State MeshLoader::getState () const {
+    if (!job)
+        return Idle;
+    return State (int (job->state));
+}
+
+void MeshLoader::getProgress (string & step, float & fraction) const {
+    step.clear ();
+    fraction = 0.f;
+    if (job)
+        job->progress.get (step, fraction);
+}
+
+string MeshLoader::getError () const {
+    return (job && job->state == Failed) ? job->error : string ();
+}
+
+bool MeshLoader::takePreview (Object & target) {
+    if (!job)
+        return false;
+    lock_guard<mutex> lock (job->previewMutex);
+    if (!job->hasPreview)
+        return false;
+    target.swap (job->preview);
+    //l'ancien objet de la scène revient dans job->preview : on le libère tout de suite
+    deleteBones (job->preview);
+    job->preview = Object ();
+    job->hasPreview = false;
+    return true;
+}
+
+bool MeshLoader::takeObject (Object & target) {
+    if (getState () != Finished)
+        return false;
+    //échange en O(1) : le thread a fini de travailler sur job->object
+    target.swap (job->object);
+    deleteBones (job->object);
+    job.reset ();
+    return true;
+}
@@ -0,0 +1,76 @@
+//
+//  MeshLoader.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 25/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MeshLoader__
+#define __Projet__MeshLoader__
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "Object.h"
+#include "Progress.h"
+
+class MeshLoader {
+    //chargement d'un mesh (et éventuellement calcul des poids) dans un thread à part, sans Qt.
+    //l'interface interroge l'état régulièrement puis récupère l'objet avec takeObject.
+    //un chargement annulé ou remplacé par un autre continue jusqu'au prochain point d'arrêt
+    //(cf Progress) dans son thread détaché, puis se libère tout seul.
+    //un gros .off sans cache est lu progressivement : après les vertices, on publie des aperçus
+    //construits sur un échantillon de faces de plus en plus dense (cf OffReader::sampleFaces),
+    //récupérés avec takePreview, avant l'objet complet.
+public:
+    typedef enum {Idle=0, Running=1, Finished=2, Failed=3, Cancelled=4} State;
+
+    MeshLoader () {}
+    virtual ~MeshLoader () { cancel (); }
+
+    //annule le chargement en cours s'il y en a un
+    void start (const std::string & filename, bool withWeights);
+    void cancel ();
+
+    State getState () const;
+    inline const std::string & getFilename () const { return filename; }
+    void getProgress (std::string & step, float & fraction) const;
+    std::string getError () const;
+
+    //échange l'objet chargé avec target (état Finished) et libère l'ancien objet
+    bool takeObject (Object & target);
+    //idem avec le dernier aperçu publié, s'il y en a un nouveau
+    bool takePreview (Object & target);
+
+    //nombre de faces du premier aperçu ; chaque aperçu suivant en a REFINE_FACTOR fois plus
+    static const unsigned int PREVIEW_FACES = 8192;
+    static const unsigned int REFINE_FACTOR = 8;
+
+private:
+    struct Job {
+        Job () : state (Running), hasPreview (false) {}
+        std::string filename;
+        bool withWeights;
+        Progress progress;
+        std::atomic<int> state;
+        std::string error;  // écrit avant le passage à l'état Failed
+        Object object;
+        std::mutex previewMutex;
+        Object preview;
+        bool hasPreview;
+    };
+
+    static void run (std::shared_ptr<Job> job);
+    //lecture progressive d'un .off, renvoie false si le fichier est trop petit pour en valoir la peine
+    static bool streamOFF (Job & job, Mesh & mesh);
+    static void publishPreview (Job & job, const std::vector<Vertex> & vertices, const std::vector<Triangle> & sample);
+    static void deleteBones (Object & object);
+
+    std::shared_ptr<Job> job;
+    std::string filename;
+};
+
+#endif /* defined(__Projet__MeshLoader__) */
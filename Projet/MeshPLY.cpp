@@ -0,0 +1,463 @@
+//
+//  MeshPLY.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 24/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "MeshPLY.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include "Mesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+//lecture d'une valeur binaire, en inversant les octets si le fichier n'est pas dans l'ordre de la machine
+template <typename T>
+static inline T readRaw (const char * p, bool swap) {
+    T value;
+    if (!swap)
+        memcpy (&value, p, sizeof (T));
+    else {
+        char bytes[sizeof (T)];
+        for (size_t i = 0; i < sizeof (T); i++)
+            bytes[i] = p[sizeof (T) - 1 - i];
+        memcpy (&value, bytes, sizeof (T));
+    }
+    return value;
+}
+
+template <typename T>
+static inline void writeRaw (char * & p, T value, bool swap) {
+    memcpy (p, &value, sizeof (T));
+    if (swap)
+        reverse (p, p + sizeof (T));
+    p += sizeof (T);
+}
+
+static double readValue (const char * p, MeshPLY::Type type, bool swap) {
+    switch (type) {
+        case MeshPLY::INT8: return *reinterpret_cast<const int8_t *> (p);
+        case MeshPLY::UINT8: return *reinterpret_cast<const uint8_t *> (p);
+        case MeshPLY::INT16: return readRaw<int16_t> (p, swap);
+        case MeshPLY::UINT16: return readRaw<uint16_t> (p, swap);
+        case MeshPLY::INT32: return readRaw<int32_t> (p, swap);
+        case MeshPLY::UINT32: return readRaw<uint32_t> (p, swap);
+        case MeshPLY::FLOAT32: return readRaw<float> (p, swap);
+        case MeshPLY::FLOAT64: return readRaw<double> (p, swap);
+        default: return 0;
+    }
+}
+
+size_t MeshPLY::typeSize (Type type) {
+    switch (type) {
+        case INT8: case UINT8: return 1;
+        case INT16: case UINT16: return 2;
+        case INT32: case UINT32: case FLOAT32: return 4;
+        case FLOAT64: return 8;
+        default: return 0;
+    }
+}
+
+static MeshPLY::Type parseType (const char * word, size_t size) {
+    static const struct { const char * name; MeshPLY::Type type; } names[] = {
+        {"char", MeshPLY::INT8}, {"int8", MeshPLY::INT8},
+        {"uchar", MeshPLY::UINT8}, {"uint8", MeshPLY::UINT8},
+        {"short", MeshPLY::INT16}, {"int16", MeshPLY::INT16},
+        {"ushort", MeshPLY::UINT16}, {"uint16", MeshPLY::UINT16},
+        {"int", MeshPLY::INT32}, {"int32", MeshPLY::INT32},
+        {"uint", MeshPLY::UINT32}, {"uint32", MeshPLY::UINT32},
+        {"float", MeshPLY::FLOAT32}, {"float32", MeshPLY::FLOAT32},
+        {"double", MeshPLY::FLOAT64}, {"float64", MeshPLY::FLOAT64}
+    };
+    for (size_t i = 0; i < sizeof (names) / sizeof (names[0]); i++)
+        if (strlen (names[i].name) == size && strncmp (names[i].name, word, size) == 0)
+            return names[i].type;
+    return MeshPLY::INVALID;
+}
+
+static inline bool isWord (const char * word, size_t size, const char * expected) {
+    return strlen (expected) == size && strncmp (word, expected, size) == 0;
+}
+
+bool MeshPLY::parseHeader (const char * begin, const char * end, Header & header) {
+    header.elements.clear ();
+    header.format = ASCII;
+    bool hasFormat = false;
+    const char * p = begin;
+    unsigned int line = 0;
+    while (p < end) {
+        const char * eol = static_cast<const char *> (memchr (p, '\n', end - p));
+        if (eol == NULL)
+            return false;
+        TextScanner scanner (p, eol);
+        p = eol + 1;
+        const char * word;
+        size_t size;
+        if (!scanner.readWord (word, size))
+            continue;
+
+        if (line++ == 0) {
+            if (!isWord (word, size, "ply"))
+                return false;
+        } else if (isWord (word, size, "format")) {
+            if (!scanner.readWord (word, size))
+                return false;
+            if (isWord (word, size, "ascii"))
+                header.format = ASCII;
+            else if (isWord (word, size, "binary_little_endian"))
+                header.format = BINARY_LITTLE_ENDIAN;
+            else if (isWord (word, size, "binary_big_endian"))
+                header.format = BINARY_BIG_ENDIAN;
+            else
+                return false;
+            hasFormat = true;
+        } else if (isWord (word, size, "element")) {
+            Element element;
+            if (!scanner.readWord (word, size) || !scanner.readUInt (element.count))
+                return false;
+            element.name.assign (word, size);
+            element.recordSize = 0;
+            header.elements.push_back (element);
+        } else if (isWord (word, size, "property")) {
+            if (header.elements.empty () || !scanner.readWord (word, size))
+                return false;
+            Property property;
+            property.countType = INVALID;
+            if (isWord (word, size, "list")) {
+                if (!scanner.readWord (word, size) || (property.countType = parseType (word, size)) == INVALID)
+                    return false;
+                if (property.countType == FLOAT32 || property.countType == FLOAT64 || !scanner.readWord (word, size))
+                    return false;
+            }
+            if ((property.type = parseType (word, size)) == INVALID || !scanner.readWord (word, size))
+                return false;
+            property.name.assign (word, size);
+            header.elements.back ().properties.push_back (property);
+        } else if (isWord (word, size, "end_header")) {
+            header.size = p - begin;
+            //taille fixe des enregistrements (0 si une liste rend la taille variable)
+            for (size_t e = 0; e < header.elements.size (); e++) {
+                Element & element = header.elements[e];
+                element.recordSize = 0;
+                for (size_t i = 0; i < element.properties.size (); i++) {
+                    if (element.properties[i].isList ()) {
+                        element.recordSize = 0;
+                        break;
+                    }
+                    element.recordSize += typeSize (element.properties[i].type);
+                }
+            }
+            return hasFormat;
+        }
+        //comment, obj_info : ignorés
+    }
+    return false;
+}
+
+static int findProperty (const MeshPLY::Element & element, const char * name, const char * alternative = NULL) {
+    for (size_t i = 0; i < element.properties.size (); i++)
+        if (element.properties[i].name == name || (alternative != NULL && element.properties[i].name == alternative))
+            return int (i);
+    return -1;
+}
+
+//enregistrement binaire de taille variable : on le parcourt propriété par propriété
+static const char * skipRecord (const char * p, const char * end, const MeshPLY::Element & element, bool swap) {
+    for (size_t i = 0; i < element.properties.size (); i++) {
+        const MeshPLY::Property & property = element.properties[i];
+        size_t size = MeshPLY::typeSize (property.type);
+        if (property.isList ()) {
+            size_t countSize = MeshPLY::typeSize (property.countType);
+            if (p + countSize > end)
+                return NULL;
+            size *= size_t (readValue (p, property.countType, swap));
+            p += countSize;
+        }
+        if (p + size > end)
+            return NULL;
+        p += size;
+    }
+    return p;
+}
+
+static inline void addPolygon (const unsigned int * indices, unsigned int polygonSize, vector<Triangle> & triangles) {
+    if (polygonSize < 3)
+        throw Mesh::Exception ("Invalid PLY face.");
+    //triangulation en éventail, comme loadOFF
+    for (unsigned int j = 2; j < polygonSize; j++)
+        triangles.push_back (Triangle (indices[0], indices[j-1], indices[j]));
+}
+
+static const char * readBinaryVertices (const char * p, const char * end, const MeshPLY::Element & element,
+                                        bool swap, vector<Vertex> & vertices) {
+    int xyz[3] = { findProperty (element, "x"), findProperty (element, "y"), findProperty (element, "z") };
+    if (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0)
+        throw Mesh::Exception ("PLY vertex without position.");
+    vertices.reserve (element.count);
+
+    if (element.recordSize == 0) {
+        for (unsigned int i = 0; i < element.count; i++) {
+            Vec3Df pos;
+            const char * q = p;
+            for (size_t k = 0; k < element.properties.size (); k++) {
+                const MeshPLY::Property & property = element.properties[k];
+                if (property.isList ()) {
+                    MeshPLY::Element single;
+                    single.properties.push_back (property);
+                    q = skipRecord (q, end, single, swap);
+                    if (q == NULL)
+                        throw Mesh::Exception ("Truncated PLY file.");
+                    continue;
+                }
+                size_t size = MeshPLY::typeSize (property.type);
+                if (q + size > end)
+                    throw Mesh::Exception ("Truncated PLY file.");
+                for (unsigned int c = 0; c < 3; c++)
+                    if (int (k) == xyz[c])
+                        pos[c] = float (readValue (q, property.type, swap));
+                q += size;
+            }
+            p = q;
+            vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
+        }
+        return p;
+    }
+
+    //enregistrements de taille fixe : position de x, y, z dans l'enregistrement, calculée une seule fois
+    if (size_t (end - p) / element.recordSize < element.count)
+        throw Mesh::Exception ("Truncated PLY file.");
+    size_t offsets[3];
+    MeshPLY::Type types[3];
+    for (unsigned int c = 0; c < 3; c++) {
+        offsets[c] = 0;
+        for (int k = 0; k < xyz[c]; k++)
+            offsets[c] += MeshPLY::typeSize (element.properties[k].type);
+        types[c] = element.properties[xyz[c]].type;
+    }
+    bool allFloat = (types[0] == MeshPLY::FLOAT32 && types[1] == MeshPLY::FLOAT32 && types[2] == MeshPLY::FLOAT32);
+    for (unsigned int i = 0; i < element.count; i++, p += element.recordSize) {
+        Vec3Df pos;
+        if (allFloat)
+            for (unsigned int c = 0; c < 3; c++)
+                pos[c] = readRaw<float> (p + offsets[c], swap);
+        else
+            for (unsigned int c = 0; c < 3; c++)
+                pos[c] = float (readValue (p + offsets[c], types[c], swap));
+        vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
+    }
+    return p;
+}
+
+static const char * readBinaryFaces (const char * p, const char * end, const MeshPLY::Element & element,
+                                     bool swap, vector<Triangle> & triangles) {
+    int list = findProperty (element, "vertex_indices", "vertex_index");
+    if (list < 0 || !element.properties[list].isList ())
+        throw Mesh::Exception ("PLY face without vertex_indices.");
+    const MeshPLY::Property & indicesProperty = element.properties[list];
+    triangles.reserve (element.count);
+    vector<unsigned int> polygon;
+
+    //cas courant : "property list uchar int vertex_indices" seule
+    if (element.properties.size () == 1 && indicesProperty.countType == MeshPLY::UINT8
+        && (indicesProperty.type == MeshPLY::INT32 || indicesProperty.type == MeshPLY::UINT32)) {
+        for (unsigned int i = 0; i < element.count; i++) {
+            if (p >= end)
+                throw Mesh::Exception ("Truncated PLY file.");
+            unsigned int polygonSize = *reinterpret_cast<const uint8_t *> (p++);
+            if (size_t (end - p) < 4 * size_t (polygonSize))
+                throw Mesh::Exception ("Truncated PLY file.");
+            polygon.resize (polygonSize);
+            for (unsigned int j = 0; j < polygonSize; j++, p += 4)
+                polygon[j] = readRaw<uint32_t> (p, swap);
+            addPolygon (polygon.data (), polygonSize, triangles);
+        }
+        return p;
+    }
+
+    for (unsigned int i = 0; i < element.count; i++) {
+        for (size_t k = 0; k < element.properties.size (); k++) {
+            const MeshPLY::Property & property = element.properties[k];
+            size_t size = MeshPLY::typeSize (property.type);
+            size_t n = 1;
+            if (property.isList ()) {
+                size_t countSize = MeshPLY::typeSize (property.countType);
+                if (p + countSize > end)
+                    throw Mesh::Exception ("Truncated PLY file.");
+                n = size_t (readValue (p, property.countType, swap));
+                p += countSize;
+            }
+            if (size_t (end - p) < n * size)
+                throw Mesh::Exception ("Truncated PLY file.");
+            if (int (k) == list) {
+                polygon.resize (n);
+                for (size_t j = 0; j < n; j++)
+                    polygon[j] = (unsigned int) (long long) (readValue (p + j * size, property.type, swap));
+                addPolygon (polygon.data (), n, triangles);
+            }
+            p += n * size;
+        }
+    }
+    return p;
+}
+
+static void readBinary (const char * p, const char * end, const MeshPLY::Header & header,
+                        vector<Vertex> & vertices, vector<Triangle> & triangles) {
+    bool swap = (header.format != MeshPLY::nativeFormat ());
+    for (size_t e = 0; e < header.elements.size (); e++) {
+        const MeshPLY::Element & element = header.elements[e];
+        if (element.name == "vertex")
+            p = readBinaryVertices (p, end, element, swap, vertices);
+        else if (element.name == "face")
+            p = readBinaryFaces (p, end, element, swap, triangles);
+        else if (element.recordSize != 0) {
+            if (size_t (end - p) / element.recordSize < element.count)
+                throw Mesh::Exception ("Truncated PLY file.");
+            p += element.recordSize * element.count;
+        } else
+            for (unsigned int i = 0; i < element.count; i++)
+                if ((p = skipRecord (p, end, element, swap)) == NULL)
+                    throw Mesh::Exception ("Truncated PLY file.");
+    }
+}
+
+static void readASCII (const char * p, const char * end, const MeshPLY::Header & header,
+                       vector<Vertex> & vertices, vector<Triangle> & triangles) {
+    TextScanner scanner (p, end);
+    vector<unsigned int> polygon;
+    for (size_t e = 0; e < header.elements.size (); e++) {
+        const MeshPLY::Element & element = header.elements[e];
+        bool isVertex = (element.name == "vertex");
+        bool isFace = (element.name == "face");
+        int xyz[3] = { findProperty (element, "x"), findProperty (element, "y"), findProperty (element, "z") };
+        int list = findProperty (element, "vertex_indices", "vertex_index");
+        if (isVertex) {
+            if (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0)
+                throw Mesh::Exception ("PLY vertex without position.");
+            vertices.reserve (element.count);
+        }
+        if (isFace) {
+            if (list < 0 || !element.properties[list].isList ())
+                throw Mesh::Exception ("PLY face without vertex_indices.");
+            triangles.reserve (element.count);
+        }
+
+        for (unsigned int i = 0; i < element.count; i++) {
+            Vec3Df pos;
+            for (size_t k = 0; k < element.properties.size (); k++) {
+                const MeshPLY::Property & property = element.properties[k];
+                if (property.isList ()) {
+                    unsigned int n;
+                    if (!scanner.readUInt (n))
+                        throw Mesh::Exception ("Invalid PLY list.");
+                    bool indices = isFace && int (k) == list;
+                    polygon.resize (indices ? n : 0);
+                    for (unsigned int j = 0; j < n; j++) {
+                        float value;
+                        bool ok = indices ? scanner.readUInt (polygon[j]) : scanner.readFloat (value);
+                        if (!ok)
+                            throw Mesh::Exception ("Invalid PLY list.");
+                    }
+                    if (indices)
+                        addPolygon (polygon.data (), n, triangles);
+                } else {
+                    float value;
+                    if (!scanner.readFloat (value))
+                        throw Mesh::Exception ("Invalid PLY value.");
+                    for (unsigned int c = 0; isVertex && c < 3; c++)
+                        if (int (k) == xyz[c])
+                            pos[c] = value;
+                }
+            }
+            if (isVertex)
+                vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
+        }
+    }
+}
+
+void MeshPLY::load (Mesh & mesh, const string & filename) {
+    MappedFile file (filename);
+    if (!file.isOpen ())
+        throw Mesh::Exception ("Failing opening the file.");
+    Header header;
+    if (!parseHeader (file.data (), file.end (), header))
+        throw Mesh::Exception ("Not a PLY file.");
+
+    vector<Vertex> & vertices = mesh.getVertices ();
+    vector<Triangle> & triangles = mesh.getTriangles ();
+    if (header.format == ASCII)
+        readASCII (file.data () + header.size, file.end (), header, vertices, triangles);
+    else
+        readBinary (file.data () + header.size, file.end (), header, vertices, triangles);
+
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            if (triangles[i].getVertex (j) >= vertices.size ())
+                throw Mesh::Exception ("Invalid PLY vertex index.");
+}
+
+void MeshPLY::save (const Mesh & mesh, const string & filename, Format format) {
+    const vector<Vertex> & vertices = mesh.getVertices ();
+    const vector<Triangle> & triangles = mesh.getTriangles ();
+
+    static const char * formatNames[] = { "ascii", "binary_little_endian", "binary_big_endian" };
+    char text[512];
+    snprintf (text, sizeof (text),
+              "ply\nformat %s 1.0\nelement vertex %u\n"
+              "property float x\nproperty float y\nproperty float z\n"
+              "property float nx\nproperty float ny\nproperty float nz\n"
+              "element face %u\nproperty list uchar int vertex_indices\nend_header\n",
+              formatNames[format], (unsigned int) vertices.size (), (unsigned int) triangles.size ());
+    string headerText = text;
+
+    //comme MeshBinary::save : un seul buffer écrit d'un coup
+    vector<char> buffer;
+    if (format == ASCII) {
+        buffer.assign (headerText.begin (), headerText.end ());
+        for (unsigned int i = 0; i < vertices.size (); i++) {
+            const Vec3Df & pos = vertices[i].getPos ();
+            const Vec3Df & normal = vertices[i].getNormal ();
+            int n = snprintf (text, sizeof (text), "%.9g %.9g %.9g %.9g %.9g %.9g\n",
+                              pos[0], pos[1], pos[2], normal[0], normal[1], normal[2]);
+            buffer.insert (buffer.end (), text, text + n);
+        }
+        for (unsigned int i = 0; i < triangles.size (); i++) {
+            int n = snprintf (text, sizeof (text), "3 %u %u %u\n",
+                              triangles[i].getVertex (0), triangles[i].getVertex (1), triangles[i].getVertex (2));
+            buffer.insert (buffer.end (), text, text + n);
+        }
+    } else {
+        bool swap = (format != nativeFormat ());
+        buffer.resize (headerText.size () + vertices.size () * 6 * sizeof (float)
+                       + triangles.size () * (1 + 3 * sizeof (int32_t)));
+        memcpy (buffer.data (), headerText.data (), headerText.size ());
+        char * p = buffer.data () + headerText.size ();
+        for (unsigned int i = 0; i < vertices.size (); i++) {
+            for (unsigned int c = 0; c < 3; c++)
+                writeRaw<float> (p, vertices[i].getPos ()[c], swap);
+            for (unsigned int c = 0; c < 3; c++)
+                writeRaw<float> (p, vertices[i].getNormal ()[c], swap);
+        }
+        for (unsigned int i = 0; i < triangles.size (); i++) {
+            *p++ = 3;
+            for (unsigned int c = 0; c < 3; c++)
+                writeRaw<int32_t> (p, triangles[i].getVertex (c), swap);
+        }
+    }
+
+    string tmpName = filename + ".tmp";
+    FILE * file = fopen (tmpName.c_str (), "wb");
+    if (file == NULL)
+        throw Mesh::Exception ("Failing opening the file " + tmpName + ".");
+    size_t written = fwrite (buffer.data (), 1, buffer.size (), file);
+    fclose (file);
+    if (written != buffer.size () || rename (tmpName.c_str (), filename.c_str ()) != 0) {
+        remove (tmpName.c_str ());
+        throw Mesh::Exception ("Failing writing the file " + filename + ".");
+    }
+}
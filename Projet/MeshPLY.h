@@ -0,0 +1,62 @@
+//
+//  MeshPLY.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 24/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__MeshPLY__
+#define __Projet__MeshPLY__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+
+class MeshPLY {
+    //lecture/écriture des .ply (modèles scannés) : binaire little ou big endian, et ascii.
+    //seuls les éléments "vertex" (x, y, z) et "face" (vertex_indices) sont gardés, les autres
+    //propriétés et éléments sont sautés. Les faces sont triangulées en éventail comme dans loadOFF.
+    //le squelette n'a pas d'équivalent en PLY : il n'est pas écrit.
+public:
+    enum Format { ASCII = 0, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+    enum Type { INVALID = 0, INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+    struct Property {
+        std::string name;
+        Type type;          // type de la valeur, ou des éléments d'une liste
+        Type countType;     // INVALID si ce n'est pas une liste
+        inline bool isList () const { return countType != INVALID; }
+    };
+
+    struct Element {
+        std::string name;
+        unsigned int count;
+        std::vector<Property> properties;
+        size_t recordSize;  // taille d'un enregistrement binaire, 0 s'il contient une liste
+    };
+
+    struct Header {
+        Format format;
+        std::vector<Element> elements;
+        size_t size;        // taille de l'en-tête, "end_header\n" compris
+    };
+
+    //remplit les vertices et les triangles du mesh (sans calculer les normales)
+    static void load (Mesh & mesh, const std::string & filename);
+    //écrit positions + normales (float) et triangles (liste uchar/int)
+    static void save (const Mesh & mesh, const std::string & filename, Format format = nativeFormat ());
+
+    static bool parseHeader (const char * begin, const char * end, Header & header);
+    static size_t typeSize (Type type);
+
+    static inline Format nativeFormat () {
+        const uint32_t one = 1;
+        return (*reinterpret_cast<const uint8_t *> (&one) == 1) ? BINARY_LITTLE_ENDIAN : BINARY_BIG_ENDIAN;
+    }
+};
+
+#endif /* defined(__Projet__MeshPLY__) */
@@ -0,0 +1,287 @@
+//
+//  Multigrid.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "Multigrid.h"
+#include "Progress.h"
+
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+const unsigned int Multigrid::COARSEST_SIZE;
+const unsigned int Multigrid::MAX_LEVELS;
+const unsigned int Multigrid::SMOOTHING_STEPS;
+
+typedef Eigen::Triplet<float> Triplet;
+
+struct CollapseEdge {
+    float length;
+    unsigned int a, b;
+    inline bool operator< (const CollapseEdge & e) const { return length < e.length; }
+};
+
+//coordonnées barycentriques de la projection de p dans le triangle (a, b, c) ; false si le triangle est dégénéré
+static bool barycentric (const Vec3Df & p, const Vec3Df & a, const Vec3Df & b, const Vec3Df & c, float lambda[3]) {
+    Vec3Df e0 = b - a, e1 = c - a, w = p - a;
+    float d00 = Vec3Df::dotProduct (e0, e0), d01 = Vec3Df::dotProduct (e0, e1), d11 = Vec3Df::dotProduct (e1, e1);
+    float d20 = Vec3Df::dotProduct (w, e0), d21 = Vec3Df::dotProduct (w, e1);
+    float denominator = d00 * d11 - d01 * d01;
+    if (denominator <= 1e-12f * d00 * d11)
+        return false;
+    lambda[1] = (d11 * d20 - d01 * d21) / denominator;
+    lambda[2] = (d00 * d21 - d01 * d20) / denominator;
+    lambda[0] = 1.f - lambda[1] - lambda[2];
+    return true;
+}
+
+void Multigrid::coarsen (const vector<Vec3Df> & positions, const vector<unsigned int> & triangles,
+                         vector<Vec3Df> & coarsePositions, vector<unsigned int> & coarseTriangles,
+                         Eigen::SparseMatrix<float> & P) {
+    const unsigned int n = positions.size ();
+
+    //arêtes (sans doublon), de la plus courte à la plus longue
+    vector<uint64_t> keys;
+    keys.reserve (triangles.size ());
+    for (unsigned int t = 0; t < triangles.size (); t += 3)
+        for (unsigned int j = 0; j < 3; j++) {
+            uint64_t a = triangles[t + j], b = triangles[t + (j+1)%3];
+            keys.push_back (a < b ? (a << 32) | b : (b << 32) | a);
+        }
+    sort (keys.begin (), keys.end ());
+    keys.erase (unique (keys.begin (), keys.end ()), keys.end ());
+    vector<CollapseEdge> edges (keys.size ());
+    for (unsigned int i = 0; i < keys.size (); i++) {
+        edges[i].a = unsigned (keys[i] >> 32);
+        edges[i].b = unsigned (keys[i] & 0xffffffffu);
+        edges[i].length = Vec3Df::squaredDistance (positions[edges[i].a], positions[edges[i].b]);
+    }
+    vector<uint64_t> ().swap (keys);
+    sort (edges.begin (), edges.end ());
+
+    //fusion b -> a, chaque vertex dans au plus une fusion
+    vector<unsigned int> target (n);
+    vector<bool> used (n, false);
+    for (unsigned int v = 0; v < n; v++)
+        target[v] = v;
+    for (unsigned int i = 0; i < edges.size (); i++) {
+        const CollapseEdge & e = edges[i];
+        if (used[e.a] || used[e.b])
+            continue;
+        used[e.a] = used[e.b] = true;
+        target[e.b] = e.a;
+    }
+    vector<CollapseEdge> ().swap (edges);
+
+    vector<unsigned int> coarseIndex (n, 0);
+    coarsePositions.clear ();
+    for (unsigned int v = 0; v < n; v++)
+        if (target[v] == v) {
+            coarseIndex[v] = coarsePositions.size ();
+            coarsePositions.push_back (positions[v]);
+        }
+    const unsigned int nc = coarsePositions.size ();
+
+    coarseTriangles.clear ();
+    for (unsigned int t = 0; t < triangles.size (); t += 3) {
+        unsigned int c[3];
+        for (unsigned int j = 0; j < 3; j++)
+            c[j] = coarseIndex[target[triangles[t + j]]];
+        if (c[0] != c[1] && c[1] != c[2] && c[0] != c[2])
+            coarseTriangles.insert (coarseTriangles.end (), c, c + 3);
+    }
+
+    //triangles grossiers de chaque vertex grossier
+    vector<unsigned int> offsets (nc + 1, 0);
+    for (unsigned int i = 0; i < coarseTriangles.size (); i++)
+        offsets[coarseTriangles[i] + 1]++;
+    for (unsigned int v = 0; v < nc; v++)
+        offsets[v + 1] += offsets[v];
+    vector<unsigned int> incident (offsets[nc]);
+    vector<unsigned int> fill (offsets.begin (), offsets.end () - 1);
+    for (unsigned int i = 0; i < coarseTriangles.size (); i++)
+        incident[fill[coarseTriangles[i]]++] = i / 3;
+
+    //prolongation : identité pour un vertex gardé ; pour un vertex supprimé, coordonnées barycentriques
+    //dans le triangle autour du vertex qui l'a absorbé qui le contient le mieux
+    vector<Triplet> triplets;
+    triplets.reserve (n + 2 * (n - nc));
+    for (unsigned int v = 0; v < n; v++) {
+        unsigned int c = coarseIndex[target[v]];
+        if (target[v] == v) {
+            triplets.push_back (Triplet (v, c, 1.f));
+            continue;
+        }
+        int best = -1;
+        float bestLambda[3], bestMin = -1e30f;
+        for (unsigned int k = offsets[c]; k < offsets[c + 1]; k++) {
+            const unsigned int * t = &coarseTriangles[3 * incident[k]];
+            float lambda[3];
+            if (!barycentric (positions[v], coarsePositions[t[0]], coarsePositions[t[1]], coarsePositions[t[2]], lambda))
+                continue;
+            float m = min (lambda[0], min (lambda[1], lambda[2]));
+            if (m > bestMin) {
+                bestMin = m;
+                best = incident[k];
+                copy (lambda, lambda + 3, bestLambda);
+            }
+        }
+        if (best < 0) {
+            triplets.push_back (Triplet (v, c, 1.f));
+            continue;
+        }
+        //hors du triangle : on ramène sur le bord (poids positifs de somme 1)
+        float sum = 0;
+        for (unsigned int j = 0; j < 3; j++) {
+            bestLambda[j] = max (0.f, bestLambda[j]);
+            sum += bestLambda[j];
+        }
+        for (unsigned int j = 0; j < 3; j++)
+            if (bestLambda[j] > 0)
+                triplets.push_back (Triplet (v, coarseTriangles[3 * best + j], bestLambda[j] / sum));
+    }
+    P.resize (n, nc);
+    P.setFromTriplets (triplets.begin (), triplets.end ());
+}
+
+void Multigrid::clear () {
+    sizes.clear ();
+    prolongations.clear ();
+    operators.clear ();
+    fine = NULL;
+    lastCycles = 0;
+}
+
+void Multigrid::build (const vector<Vertex> & vertices, const vector<Triangle> & triangles) {
+    clear ();
+    vector<Vec3Df> positions (vertices.size ());
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        positions[i] = vertices[i].getPos ();
+    vector<unsigned int> indices (3 * triangles.size ());
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            indices[3*i + j] = triangles[i].getVertex (j);
+
+    sizes.push_back (positions.size ());
+    while (sizes.size () < MAX_LEVELS && positions.size () > COARSEST_SIZE) {
+        vector<Vec3Df> coarsePositions;
+        vector<unsigned int> coarseIndices;
+        Eigen::SparseMatrix<float> P;
+        coarsen (positions, indices, coarsePositions, coarseIndices, P);
+        //presque plus d'arête à fusionner (nuage de points, composantes isolées) : on s'arrête là
+        if (coarsePositions.size () > 0.9 * positions.size ())
+            break;
+        prolongations.push_back (P);
+        sizes.push_back (coarsePositions.size ());
+        positions.swap (coarsePositions);
+        indices.swap (coarseIndices);
+    }
+}
+
+//Gauss-Seidel sur toutes les colonnes à la fois (une ligne de x = les poids d'un vertex pour tous les bones).
+//A est symétrique : sa colonne i est aussi sa ligne i.
+void Multigrid::smooth (const Eigen::SparseMatrix<float> & A, const Block & b, Block & x, bool forward) {
+    const int n = A.outerSize ();
+    Eigen::Matrix<float, 1, Eigen::Dynamic> sum (x.cols ());
+    for (int k = 0; k < n; k++) {
+        int i = forward ? k : n - 1 - k;
+        sum = b.row (i);
+        float diagonal = 0;
+        for (Eigen::SparseMatrix<float>::InnerIterator it (A, i); it; ++it) {
+            if (it.row () == i)
+                diagonal = it.value ();
+            else
+                sum -= it.value () * x.row (it.row ());
+        }
+        if (diagonal != 0)
+            x.row (i) = sum / diagonal;
+    }
+}
+
+void Multigrid::cycle (unsigned int level, const Block & b, Block & x) {
+    const Eigen::SparseMatrix<float> & A = matrix (level);
+    if (level + 1 == sizes.size ()) {
+        Eigen::MatrixXf solution = coarseSolver.solve (Eigen::MatrixXf (b));
+        x = solution;
+        return;
+    }
+    for (unsigned int s = 0; s < SMOOTHING_STEPS; s++)
+        smooth (A, b, x, true);
+
+    const Eigen::SparseMatrix<float> & P = prolongations[level];
+    Block residual = b - A * x;
+    Block coarseRhs = P.transpose () * residual;
+    Block correction = Block::Zero (coarseRhs.rows (), coarseRhs.cols ());
+    cycle (level + 1, coarseRhs, correction);
+    x += P * correction;
+
+    for (unsigned int s = 0; s < SMOOTHING_STEPS; s++)
+        smooth (A, b, x, false);
+}
+
+bool Multigrid::solve (const Eigen::SparseMatrix<float> & A, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x,
+                       float tolerance, unsigned int maxCycles, Progress * progress) {
+    lastCycles = 0;
+    if (empty () || A.rows () != int (sizes[0]))
+        return false;
+
+    //matrices de Galerkin, du plus fin au plus grossier
+    fine = &A;
+    operators.resize (sizes.size ());
+    for (unsigned int l = 1; l < sizes.size (); l++) {
+        const Eigen::SparseMatrix<float> & P = prolongations[l-1];
+        Eigen::SparseMatrix<float> AP = matrix (l-1) * P;
+        operators[l] = P.transpose () * AP;
+    }
+    coarseSolver.compute (matrix (sizes.size () - 1));
+    if (coarseSolver.info () != Eigen::Success)
+        return false;
+
+    //gradient conjugué préconditionné par un V-cycle (symétrique : Gauss-Seidel avant à la descente,
+    //arrière à la remontée, départ à zéro). Un V-cycle seul stagne sur les gros meshes irréguliers ;
+    //comme préconditionneur il garde un nombre d'itérations à peu près indépendant de la taille.
+    //chaque colonne (bone) a ses propres pas alpha et beta.
+    Block b = rhs;
+    Block solution = (x.rows () == rhs.rows () && x.cols () == rhs.cols ()) ? Block (x) : Block (Block::Zero (rhs.rows (), rhs.cols ()));
+    const float target = tolerance * b.norm ();
+    Block residual = b - A * solution;
+    bool converged = residual.norm () <= target;
+    if (!converged) {
+        Block z = Block::Zero (b.rows (), b.cols ());
+        cycle (0, residual, z);
+        Block direction = z;
+        Eigen::ArrayXf rz = residual.cwiseProduct (z).colwise ().sum ().transpose ().array ();
+        while (!converged && lastCycles < maxCycles) {
+            if (progress && progress->isCancelled ()) {
+                operators.clear ();
+                fine = NULL;
+                throw Progress::Cancelled ();
+            }
+            Block Ap = A * direction;
+            Eigen::ArrayXf pAp = direction.cwiseProduct (Ap).colwise ().sum ().transpose ().array ();
+            Eigen::ArrayXf alpha = (pAp > 0).select (rz / pAp, 0.f);
+            solution += direction * alpha.matrix ().asDiagonal ();
+            residual -= Ap * alpha.matrix ().asDiagonal ();
+            lastCycles++;
+            converged = residual.norm () <= target;
+            if (converged)
+                break;
+            z.setZero ();
+            cycle (0, residual, z);
+            Eigen::ArrayXf rzNew = residual.cwiseProduct (z).colwise ().sum ().transpose ().array ();
+            Eigen::ArrayXf beta = (rz > 0).select (rzNew / rz, 0.f);
+            direction = z + direction * beta.matrix ().asDiagonal ();
+            rz = rzNew;
+        }
+    }
+    x = solution;
+    //les matrices grossières ne servent plus : on ne garde que la hiérarchie
+    operators.clear ();
+    fine = NULL;
+    return converged;
+}
@@ -0,0 +1,69 @@
+//
+//  Multigrid.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__Multigrid__
+#define __Projet__Multigrid__
+
+#include <vector>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class Progress;
+
+class Multigrid {
+    //multigrille géométrique pour le système des poids (-L + H) W = H P (cf WeightSolver).
+    //hiérarchie : à chaque niveau on fusionne les arêtes les plus courtes (un vertex participe à au plus une
+    //fusion par niveau, le vertex gardé ne bouge pas), jusqu'à COARSEST_SIZE vertices. Un vertex supprimé
+    //est prolongé par ses coordonnées barycentriques dans un triangle grossier autour du vertex qui l'a absorbé.
+    //les matrices grossières sont celles de Galerkin (P^T A P) : seule la hiérarchie dépend du mesh, les
+    //matrices sont refaites à chaque résolution (O(V)) puisque H change avec le squelette.
+    //tous les bones sont résolus ensemble (une colonne par bone) ; un V-cycle coûte O(V). Le V-cycle sert de
+    //préconditionneur à un gradient conjugué, qui converge en quelques itérations là où les V-cycles seuls stagnent.
+public:
+    static const unsigned int COARSEST_SIZE = 2000;
+    static const unsigned int MAX_LEVELS = 24;
+    static const unsigned int SMOOTHING_STEPS = 2;
+
+    Multigrid () : fine (NULL), lastCycles (0) {}
+
+    //hiérarchie du mesh (ne dépend que des vertices et des triangles)
+    void build (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles);
+    void clear ();
+    inline bool empty () const { return sizes.empty (); }
+    inline unsigned int getNbLevels () const { return sizes.size (); }
+    inline unsigned int getLevelSize (unsigned int level) const { return sizes[level]; }
+
+    //gradient conjugué préconditionné par un V-cycle jusqu'à |rhs - A x| <= tolerance |rhs| (ou maxCycles) ; x sert de point de départ s'il a
+    //la bonne taille. Renvoie false si le système grossier ne se factorise pas ou si ça ne converge pas.
+    //progress (optionnel) est consulté à chaque itération
+    bool solve (const Eigen::SparseMatrix<float> & A, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x,
+                float tolerance, unsigned int maxCycles = 100, Progress * progress = NULL);
+    inline unsigned int getLastCycles () const { return lastCycles; }
+
+private:
+    typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> Block;
+
+    static void coarsen (const std::vector<Vec3Df> & positions, const std::vector<unsigned int> & triangles,
+                         std::vector<Vec3Df> & coarsePositions, std::vector<unsigned int> & coarseTriangles,
+                         Eigen::SparseMatrix<float> & P);
+    static void smooth (const Eigen::SparseMatrix<float> & A, const Block & b, Block & x, bool forward);
+    void cycle (unsigned int level, const Block & b, Block & x);
+    inline const Eigen::SparseMatrix<float> & matrix (unsigned int level) const { return level == 0 ? *fine : operators[level]; }
+
+    std::vector<unsigned int> sizes;                        // nombre de vertices de chaque niveau (0 = mesh)
+    std::vector< Eigen::SparseMatrix<float> > prolongations; // prolongations[l] : niveau l+1 -> niveau l
+    std::vector< Eigen::SparseMatrix<float> > operators;     // operators[l] = P^T A P (l >= 1)
+    const Eigen::SparseMatrix<float> * fine;
+    Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> > coarseSolver;
+    unsigned int lastCycles;
+};
+
+#endif /* defined(__Projet__Multigrid__) */
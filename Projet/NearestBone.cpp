@@ -0,0 +1,327 @@
+//
+//  NearestBone.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 29/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "NearestBone.h"
+#include "Armature.h"
+#include "TriangleBVH.h"
+#include "Progress.h"
+#include "Threads.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+const unsigned int NearestBone::LANES;
+const unsigned int NearestBone::BVH_THRESHOLD;
+const unsigned int NearestBone::LEAF_SIZE;
+const size_t NearestBone::MIN_VERTICES_PER_THREAD;
+const size_t NearestBone::MIN_HIDDEN_PER_THREAD;
+const float NearestBone::TIE_TOLERANCE = 1e-5f;
+
+//les distances sont comparées au carré
+static const float TIE_FACTOR2 = (1.f + NearestBone::TIE_TOLERANCE) * (1.f + NearestBone::TIE_TOLERANCE);
+
+NearestBone::NearestBone () : useBVH (false), nbThreads (defaultNbThreads ()) {}
+
+void NearestBone::build (const vector<Vertex> & vertices_bones, const vector<Armature *> & bones) {
+    ax.clear (); ay.clear (); az.clear ();
+    dx.clear (); dy.clear (); dz.clear ();
+    invLength2.clear ();
+    nodes.clear ();
+    order.clear ();
+    for (unsigned int i = 0; i < bones.size (); i++) {
+        Vec3Df a = vertices_bones[bones[i]->getVertex (0)].getPos ();
+        //un handle est un segment de longueur nulle
+        Vec3Df d (0, 0, 0);
+        if (bones[i]->getType () == "bone")
+            d = vertices_bones[bones[i]->getVertex (1)].getPos () - a;
+        float length2 = Vec3Df::dotProduct (d, d);
+        ax.push_back (a[0]); ay.push_back (a[1]); az.push_back (a[2]);
+        dx.push_back (d[0]); dy.push_back (d[1]); dz.push_back (d[2]);
+        invLength2.push_back (length2 > 0 ? 1.f / length2 : 0.f);
+    }
+    useBVH = false;
+    setUseBVH (bones.size () >= BVH_THRESHOLD);
+}
+
+void NearestBone::setUseBVH (bool b) {
+    useBVH = b && !ax.empty ();
+    if (useBVH && nodes.empty ())
+        buildBVH ();
+}
+
+inline float NearestBone::segmentDistance2 (unsigned int s, const Vec3Df & p) const {
+    float wx = p[0] - ax[s], wy = p[1] - ay[s], wz = p[2] - az[s];
+    float t = (wx * dx[s] + wy * dy[s] + wz * dz[s]) * invLength2[s];
+    t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+    float ex = wx - t * dx[s], ey = wy - t * dy[s], ez = wz - t * dz[s];
+    return ex * ex + ey * ey + ez * ez;
+}
+
+Vec3Df NearestBone::closestPoint (unsigned int s, const Vec3Df & p) const {
+    float t = ((p[0] - ax[s]) * dx[s] + (p[1] - ay[s]) * dy[s] + (p[2] - az[s]) * dz[s]) * invLength2[s];
+    t = (t < 0.f) ? 0.f : ((t > 1.f) ? 1.f : t);
+    return Vec3Df (ax[s] + t * dx[s], ay[s] + t * dy[s], az[s] + t * dz[s]);
+}
+
+inline float NearestBone::boxDistance2 (const Node & node, const Vec3Df & p) const {
+    float d2 = 0;
+    for (unsigned int c = 0; c < 3; c++) {
+        float e = max (0.f, max (node.min[c] - p[c], p[c] - node.max[c]));
+        d2 += e * e;
+    }
+    return d2;
+}
+
+//n <= LANES vertices ; les voies inutilisées répètent le dernier vertex
+void NearestBone::queryBlock (const float * px, const float * py, const float * pz, Result * results, unsigned int n) const {
+    float best[LANES];
+    int bestBone[LANES];
+    unsigned int nbTies[LANES];
+    for (unsigned int l = 0; l < LANES; l++) {
+        best[l] = numeric_limits<float>::max ();
+        bestBone[l] = -1;
+        nbTies[l] = 0;
+    }
+    const unsigned int nbSegments = ax.size ();
+
+    //1er passage : distance minimale (le premier bone l'emporte en cas d'égalité exacte)
+    for (unsigned int s = 0; s < nbSegments; s++) {
+        const float sax = ax[s], say = ay[s], saz = az[s];
+        const float sdx = dx[s], sdy = dy[s], sdz = dz[s], sinv = invLength2[s];
+        for (unsigned int l = 0; l < LANES; l++) {
+            float wx = px[l] - sax, wy = py[l] - say, wz = pz[l] - saz;
+            float t = (wx * sdx + wy * sdy + wz * sdz) * sinv;
+            t = min (max (t, 0.f), 1.f);
+            float ex = wx - t * sdx, ey = wy - t * sdy, ez = wz - t * sdz;
+            float d2 = ex * ex + ey * ey + ez * ez;
+            bool closer = d2 < best[l];
+            best[l] = closer ? d2 : best[l];
+            bestBone[l] = closer ? int (s) : bestBone[l];
+        }
+    }
+
+    //2e passage : bones à égalité avec le plus proche
+    float limit[LANES];
+    for (unsigned int l = 0; l < LANES; l++)
+        limit[l] = best[l] * TIE_FACTOR2;
+    for (unsigned int s = 0; s < nbSegments; s++) {
+        const float sax = ax[s], say = ay[s], saz = az[s];
+        const float sdx = dx[s], sdy = dy[s], sdz = dz[s], sinv = invLength2[s];
+        for (unsigned int l = 0; l < LANES; l++) {
+            float wx = px[l] - sax, wy = py[l] - say, wz = pz[l] - saz;
+            float t = (wx * sdx + wy * sdy + wz * sdz) * sinv;
+            t = min (max (t, 0.f), 1.f);
+            float ex = wx - t * sdx, ey = wy - t * sdy, ez = wz - t * sdz;
+            float d2 = ex * ex + ey * ey + ez * ez;
+            nbTies[l] += (d2 <= limit[l]) ? 1 : 0;
+        }
+    }
+
+    for (unsigned int l = 0; l < n; l++) {
+        results[l].bone = bestBone[l];
+        results[l].nbTies = nbTies[l];
+        results[l].distance = sqrt (best[l]);
+        results[l].hidden = false;
+    }
+}
+
+NearestBone::Result NearestBone::query (const Vec3Df & p) const {
+    Result result;
+    if (!useBVH) {
+        float px[LANES], py[LANES], pz[LANES];
+        for (unsigned int l = 0; l < LANES; l++) {
+            px[l] = p[0];
+            py[l] = p[1];
+            pz[l] = p[2];
+        }
+        queryBlock (px, py, pz, &result, 1);
+        return result;
+    }
+
+    //plus proche segment : on descend d'abord dans le fils le plus proche
+    float best = numeric_limits<float>::max ();
+    int bestBone = -1;
+    unsigned int stack[64];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node & node = nodes[stack[--top]];
+        if (boxDistance2 (node, p) > best)
+            continue;
+        if (node.count > 0) {
+            for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                unsigned int s = order[i];
+                float d2 = segmentDistance2 (s, p);
+                if (d2 < best || (d2 == best && int (s) < bestBone)) {
+                    best = d2;
+                    bestBone = s;
+                }
+            }
+            continue;
+        }
+        float dLeft = boxDistance2 (nodes[node.left], p), dRight = boxDistance2 (nodes[node.right], p);
+        if (dLeft < dRight) {
+            stack[top++] = node.right;
+            stack[top++] = node.left;
+        } else {
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+        }
+    }
+
+    //égalités : tous les segments à moins de limit
+    float limit = best * TIE_FACTOR2;
+    unsigned int nbTies = 0;
+    top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node & node = nodes[stack[--top]];
+        if (boxDistance2 (node, p) > limit)
+            continue;
+        if (node.count > 0) {
+            for (unsigned int i = node.first; i < node.first + node.count; i++)
+                if (segmentDistance2 (order[i], p) <= limit)
+                    nbTies++;
+            continue;
+        }
+        stack[top++] = node.left;
+        stack[top++] = node.right;
+    }
+
+    result.bone = bestBone;
+    result.nbTies = nbTies;
+    result.distance = sqrt (best);
+    result.hidden = false;
+    return result;
+}
+
+void NearestBone::queryRange (const vector<Vertex> & vertices, size_t begin, size_t end, vector<Result> & results) const {
+    if (useBVH) {
+        for (size_t i = begin; i < end; i++)
+            results[i] = query (vertices[i].getPos ());
+        return;
+    }
+    for (size_t i = begin; i < end; i += LANES) {
+        unsigned int n = min<size_t> (LANES, end - i);
+        float px[LANES], py[LANES], pz[LANES];
+        for (unsigned int l = 0; l < LANES; l++) {
+            const Vec3Df & p = vertices[i + min (l, n - 1)].getPos ();
+            px[l] = p[0];
+            py[l] = p[1];
+            pz[l] = p[2];
+        }
+        queryBlock (px, py, pz, &results[i], n);
+    }
+}
+
+void NearestBone::query (const vector<Vertex> & vertices, vector<Result> & results) const {
+    results.resize (vertices.size ());
+    //tranches contiguës (multiples de LANES) de vertices
+    size_t nbChunks = max<size_t> (1, min<size_t> (nbThreads, vertices.size () / MIN_VERTICES_PER_THREAD));
+    size_t nbBlocks = (vertices.size () + LANES - 1) / LANES;
+    vector<thread> workers;
+    for (size_t c = 1; c < nbChunks; c++)
+        workers.push_back (thread (&NearestBone::queryRange, this, cref (vertices), LANES * (nbBlocks * c / nbChunks),
+                                   min (vertices.size (), LANES * (nbBlocks * (c+1) / nbChunks)), ref (results)));
+    queryRange (vertices, 0, min (vertices.size (), LANES * (nbBlocks / nbChunks)), results);
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+}
+
+void NearestBone::searchVisible (const Vec3Df & p, const TriangleBVH & occluders,
+                                 vector<pair<float, unsigned int> > & candidates, Result & result) const {
+    //tas des bones dans l'ordre (distance, index) : le premier candidat est le plus souvent visible,
+    //inutile de tout trier
+    for (unsigned int s = 0; s < candidates.size (); s++)
+        candidates[s] = make_pair (segmentDistance2 (s, p), s);
+    greater<pair<float, unsigned int> > after;
+    make_heap (candidates.begin (), candidates.end (), after);
+    for (vector<pair<float, unsigned int> >::iterator end = candidates.end (); end != candidates.begin (); --end) {
+        pop_heap (candidates.begin (), end, after);
+        const pair<float, unsigned int> & candidate = *(end - 1);
+        if (int (candidate.second) == result.bone)
+            continue;
+        if (!occluders.occluded (p, closestPoint (candidate.second, p))) {
+            result.bone = candidate.second;
+            result.nbTies = 1;
+            result.distance = sqrt (candidate.first);
+            return;
+        }
+    }
+    //aucun bone visible (squelette qui sort du mesh, surface ouverte...) : on garde le plus proche,
+    //sinon H serait nul sur toute une partie du mesh et le système ne serait plus inversible
+    result.hidden = true;
+}
+
+void NearestBone::queryVisible (const vector<Vertex> & vertices, const TriangleBVH & occluders, vector<Result> & results,
+                                Progress * progress) const {
+    query (vertices, results);
+    if (occluders.empty () || ax.empty ())
+        return;
+    if (progress)
+        progress->set ("Bones visibles", 0.f);
+
+    //1er lot : chaque vertex vers son bone le plus proche (presque tous sont visibles)
+    vector<TriangleBVH::Segment> segments (vertices.size ());
+    for (unsigned int i = 0; i < vertices.size (); i++) {
+        segments[i].a = vertices[i].getPos ();
+        segments[i].b = closestPoint (results[i].bone, segments[i].a);
+    }
+    vector<char> occluded;
+    occluders.occluded (segments, occluded);
+    vector<unsigned int> pending;
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        if (occluded[i])
+            pending.push_back (i);
+    if (pending.empty ())
+        return;
+    if (progress)
+        progress->set ("Bones visibles", 0.5f);
+
+    //vertices cachés : chaque thread prend le prochain et cherche son bone visible
+    atomic<size_t> next (0);
+    auto worker = [&] () {
+        vector<pair<float, unsigned int> > candidates (ax.size ());
+        for (size_t k = next++; k < pending.size (); k = next++) {
+            if (progress && progress->isCancelled ())
+                return;
+            searchVisible (vertices[pending[k]].getPos (), occluders, candidates, results[pending[k]]);
+        }
+    };
+    size_t nbWorkers = max<size_t> (1, min<size_t> (nbThreads, pending.size () / MIN_HIDDEN_PER_THREAD));
+    vector<thread> workers;
+    for (size_t i = 1; i < nbWorkers; i++)
+        workers.push_back (thread (worker));
+    worker ();
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+    //lève Progress::Cancelled si la recherche a été interrompue
+    if (progress)
+        progress->set ("Bones visibles", 1.f);
+}
+
+void NearestBone::buildBVH () {
+    //boîte et milieu de chaque segment
+    vector<float> bounds (6 * ax.size ()), centers (3 * ax.size ());
+    for (unsigned int s = 0; s < ax.size (); s++) {
+        float a[3] = {ax[s], ay[s], az[s]};
+        float d[3] = {dx[s], dy[s], dz[s]};
+        for (unsigned int c = 0; c < 3; c++) {
+            bounds[6*s + c] = min (a[c], a[c] + d[c]);
+            bounds[6*s + 3 + c] = max (a[c], a[c] + d[c]);
+            centers[3*s + c] = a[c] + 0.5f * d[c];
+        }
+    }
+    MedianSplitBVH::build (bounds, centers, LEAF_SIZE, nodes, order);
+}
@@ -0,0 +1,88 @@
+//
+//  NearestBone.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 29/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__NearestBone__
+#define __Projet__NearestBone__
+
+#include <vector>
+#include <utility>
+
+#include "Vertex.h"
+#include "MedianSplitBVH.h"
+
+class Armature;
+class TriangleBVH;
+class Progress;
+
+class NearestBone {
+    //bone le plus proche de chaque vertex, pour la matrice H de Mesh::computeWeights : distance au segment
+    //pour un bone, au point pour un handle. Les distances sont calculées 8 vertices à la fois (les boucles sur
+    //les 8 voies sont vectorisées par le compilateur). A partir de BVH_THRESHOLD bones, chaque vertex
+    //parcourt un BVH des segments au lieu de tester tous les bones.
+    //les bones à égalité (à TIE_TOLERANCE près, en relatif) sont comptés : H(i) = nbTies / distance.
+    //queryVisible ne garde que les bones visibles : le segment du vertex au point le plus proche du bone
+    //ne doit pas traverser la surface (cf TriangleBVH), sinon un vertex du bras peut se lier à la jambe.
+    //les requêtes sur tout le mesh sont réparties sur plusieurs threads.
+public:
+    static const unsigned int LANES = 8;
+    static const unsigned int BVH_THRESHOLD = 32;
+    static const unsigned int LEAF_SIZE = 4;
+    //en dessous de ce nombre de vertices (cachés pour queryVisible) par thread, on ne découpe pas
+    static const size_t MIN_VERTICES_PER_THREAD = 4 * 1024;
+    static const size_t MIN_HIDDEN_PER_THREAD = 64;
+    static const float TIE_TOLERANCE;
+
+    struct Result {
+        int bone;               // -1 s'il n'y a pas de bone
+        unsigned int nbTies;    // nombre de bones à la distance minimale (1 sans égalité)
+        float distance;
+        bool hidden;            // queryVisible : aucun bone visible, on a gardé le plus proche
+    };
+
+    NearestBone ();
+
+    inline void setNbThreads (unsigned int n) { nbThreads = n; }
+    inline unsigned int getNbThreads () const { return nbThreads; }
+
+    void build (const std::vector<Vertex> & vertices_bones, const std::vector<Armature *> & bones);
+    void query (const std::vector<Vertex> & vertices, std::vector<Result> & results) const;
+    Result query (const Vec3Df & p) const;
+    //plus proche bone visible : les segments vers le bone le plus proche sont testés en un lot, puis chaque
+    //vertex caché essaie ses autres bones du plus proche au plus lointain (ordre (distance, index)) jusqu'au
+    //premier visible ; progress (optionnel) : l'annulation interrompt la recherche
+    void queryVisible (const std::vector<Vertex> & vertices, const TriangleBVH & occluders, std::vector<Result> & results,
+                       Progress * progress = NULL) const;
+
+    inline unsigned int getNbBones () const { return ax.size (); }
+    inline bool usesBVH () const { return useBVH; }
+    //force (ou non) le BVH quel que soit le nombre de bones
+    void setUseBVH (bool b);
+
+private:
+    //feuille : segments order[first .. first+count-1] (cf MedianSplitBVH)
+    typedef MedianSplitBVH::Node Node;
+
+    void queryBlock (const float * px, const float * py, const float * pz, Result * results, unsigned int n) const;
+    void queryRange (const std::vector<Vertex> & vertices, size_t begin, size_t end, std::vector<Result> & results) const;
+    //candidates : tampon de travail (un par thread)
+    void searchVisible (const Vec3Df & p, const TriangleBVH & occluders,
+                        std::vector<std::pair<float, unsigned int> > & candidates, Result & result) const;
+    void buildBVH ();
+    float segmentDistance2 (unsigned int s, const Vec3Df & p) const;
+    Vec3Df closestPoint (unsigned int s, const Vec3Df & p) const;
+    float boxDistance2 (const Node & node, const Vec3Df & p) const;
+
+    //segments en SoA : origine a, direction d = b - a, 1 / |d|^2 (0 pour un handle)
+    std::vector<float> ax, ay, az, dx, dy, dz, invLength2;
+    bool useBVH;
+    unsigned int nbThreads;
+    std::vector<Node> nodes;
+    std::vector<unsigned int> order;
+};
+
+#endif /* defined(__Projet__NearestBone__) */
@@ -0,0 +1,256 @@
+//
+//  ObjParser.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 21/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "ObjParser.h"
+#include "Threads.h"
+#include "MappedFile.h"
+#include "TextScanner.h"
+#include "Mesh.h"
+
+#include <thread>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+const size_t ObjParser::MIN_CHUNK_SIZE;
+
+ObjParser::ObjParser () : nbThreads (defaultNbThreads ()) {}
+
+void ObjParser::parseChunk (const char * begin, const char * end, Chunk & chunk) {
+    chunk.clear ();
+    //le premier segment hérite du mode du morceau précédent (inconnu à ce stade)
+    chunk.push_back (Segment (-1));
+
+    const char * p = begin;
+    while (p < end) {
+        const char * eol = static_cast<const char *> (memchr (p, '\n', end - p));
+        const char * lineEnd = (eol == NULL) ? end : eol;
+        const char * next = (eol == NULL) ? end : eol + 1;
+
+        //comme avant : une ligne qui contient un # est un commentaire
+        if (memchr (p, '#', lineEnd - p) != NULL) {
+            p = next;
+            continue;
+        }
+
+        TextScanner scanner (p, lineEnd);
+        const char * word;
+        size_t size;
+        if (!scanner.readWord (word, size)) {
+            p = next;
+            continue;
+        }
+
+        if (size == 1 && word[0] == 'o') {
+            chunk.push_back (Segment (1));
+
+        } else if (size == 1 && word[0] == 's') {
+            chunk.push_back (Segment (0));
+
+        } else if (size == 1 && word[0] == 'v') {
+            //une coordonnée manquante vaut 0 (comme atof) pour garder la numérotation des vertices
+            float pos[3] = {0.f, 0.f, 0.f};
+            for (unsigned int i = 0; i < 3; i++)
+                if (!scanner.readFloat (pos[i]))
+                    break;
+            vector<float> & positions = chunk.back ().positions;
+            positions.push_back (pos[0]);
+            positions.push_back (pos[1]);
+            positions.push_back (pos[2]);
+
+        } else if (size == 1 && word[0] == 'f') {
+            //"f 1/1/1 2/2/2 3/3/3 ..." : on garde l'index du vertex et on triangule en éventail
+            vector<unsigned int> & faces = chunk.back ().faces;
+            size_t start = faces.size ();
+            unsigned int first = 0, previous = 0, current;
+            unsigned int nb = 0;
+            bool valid = true;
+            while (true) {
+                scanner.skipBlanks ();
+                if (scanner.atEnd ())
+                    break;
+                if (!scanner.readUInt (current)) {
+                    valid = false;
+                    break;
+                }
+                scanner.skipWord ();
+                if (nb == 0)
+                    first = current;
+                else if (nb >= 2) {
+                    faces.push_back (first);
+                    faces.push_back (previous);
+                    faces.push_back (current);
+                }
+                previous = current;
+                nb++;
+            }
+            if (!valid)
+                faces.resize (start);
+
+        } else if (size == 1 && word[0] == 'l') {
+            //c'est un bone seulement si la ligne a exactement deux index
+            Link link;
+            unsigned int nb = 0, index;
+            while (nb < 3 && scanner.readUInt (index)) {
+                if (nb < 2)
+                    link.index[nb] = index;
+                nb++;
+            }
+            scanner.skipBlanks ();
+            if (nb == 2 && scanner.atEnd ()) {
+                Segment & segment = chunk.back ();
+                link.localVertices = segment.positions.size () / 3;
+                link.handle = false;
+                segment.links.push_back (link);
+            }
+
+        } else if (size == 2 && word[0] == 'l' && word[1] == 'v') {
+            //c'est un handle seulement si la ligne a exactement un index
+            Link link;
+            scanner.skipBlanks ();
+            if (scanner.readUInt (link.index[0])) {
+                scanner.skipBlanks ();
+                if (scanner.atEnd ()) {
+                    Segment & segment = chunk.back ();
+                    link.index[1] = link.index[0];
+                    link.localVertices = segment.positions.size () / 3;
+                    link.handle = true;
+                    segment.links.push_back (link);
+                }
+            }
+        }
+
+        p = next;
+    }
+}
+
+//position de chaque segment dans les tableaux finaux
+struct SegmentInfo {
+    const ObjParser::Segment * segment;
+    bool object;
+    size_t vertexOffset;
+    size_t objectVerticesBefore;
+    size_t triangleOffset;
+};
+
+static void fillChunk (const vector<SegmentInfo> & infos, size_t first, size_t last,
+                       vector<Vertex> & vertices, vector<Triangle> & triangles, vector<Vertex> & vertices_bones) {
+    for (size_t s = first; s < last; s++) {
+        const SegmentInfo & info = infos[s];
+        const vector<float> & positions = info.segment->positions;
+        vector<Vertex> & target = info.object ? vertices : vertices_bones;
+        for (size_t i = 0, n = positions.size () / 3; i < n; i++)
+            target[info.vertexOffset + i] = Vertex (Vec3Df (positions[3*i], positions[3*i+1], positions[3*i+2]),
+                                                    Vec3Df (1.0, 0.0, 0.0));
+        //on enlève 1 car dans un .obj, l'index des vertices commencent à 1 et non 0 !
+        const vector<unsigned int> & faces = info.segment->faces;
+        for (size_t i = 0, n = faces.size () / 3; i < n; i++)
+            triangles[info.triangleOffset + i] = Triangle (faces[3*i] - 1, faces[3*i+1] - 1, faces[3*i+2] - 1);
+    }
+}
+
+void ObjParser::parse (const MappedFile & file,
+                       vector<Vertex> & vertices,
+                       vector<Triangle> & triangles,
+                       vector<Vertex> & vertices_bones,
+                       vector<Armature *> & bones) const {
+
+    const char * data = file.data ();
+    size_t size = file.size ();
+
+    //découpage en morceaux alignés sur les fins de ligne
+    size_t nbChunks = max<size_t> (1, min<size_t> (nbThreads, size / MIN_CHUNK_SIZE));
+    vector<const char *> bounds (nbChunks + 1);
+    bounds[0] = data;
+    for (size_t i = 1; i < nbChunks; i++) {
+        const char * p = data + size * i / nbChunks;
+        if (p < bounds[i-1])
+            p = bounds[i-1];
+        const char * eol = static_cast<const char *> (memchr (p, '\n', file.end () - p));
+        bounds[i] = (eol == NULL) ? file.end () : eol + 1;
+    }
+    bounds[nbChunks] = file.end ();
+
+    vector<Chunk> chunks (nbChunks);
+    vector<thread> workers;
+    for (size_t i = 1; i < nbChunks; i++)
+        workers.push_back (thread (&ObjParser::parseChunk, bounds[i], bounds[i+1], ref (chunks[i])));
+    parseChunk (bounds[0], bounds[1], chunks[0]);
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+
+    //fusion : on parcourt les segments dans l'ordre du fichier pour retrouver le mode ("o"/"s")
+    //et les décalages de chaque segment
+    vector<SegmentInfo> infos;
+    vector<size_t> chunkFirstSegment (nbChunks + 1);
+    bool obj = true;
+    size_t nbObjectVertices = 0, nbBoneVertices = 0, nbTriangles = 0;
+    for (size_t c = 0; c < nbChunks; c++) {
+        chunkFirstSegment[c] = infos.size ();
+        for (size_t s = 0; s < chunks[c].size (); s++) {
+            const Segment & segment = chunks[c][s];
+            if (segment.mode != -1)
+                obj = (segment.mode == 1);
+            SegmentInfo info;
+            info.segment = &segment;
+            info.object = obj;
+            info.vertexOffset = obj ? nbObjectVertices : nbBoneVertices;
+            info.objectVerticesBefore = nbObjectVertices;
+            info.triangleOffset = nbTriangles;
+            infos.push_back (info);
+            if (obj)
+                nbObjectVertices += segment.positions.size () / 3;
+            else
+                nbBoneVertices += segment.positions.size () / 3;
+            nbTriangles += segment.faces.size () / 3;
+        }
+    }
+    chunkFirstSegment[nbChunks] = infos.size ();
+
+    vertices.resize (nbObjectVertices);
+    vertices_bones.resize (nbBoneVertices);
+    triangles.resize (nbTriangles);
+
+    //recopie en parallèle, un thread par morceau
+    workers.clear ();
+    for (size_t c = 1; c < nbChunks; c++)
+        workers.push_back (thread (fillChunk, cref (infos), chunkFirstSegment[c], chunkFirstSegment[c+1],
+                                   ref (vertices), ref (triangles), ref (vertices_bones)));
+    fillChunk (infos, chunkFirstSegment[0], chunkFirstSegment[1], vertices, triangles, vertices_bones);
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+
+    for (size_t i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            if (triangles[i].getVertex (j) >= vertices.size ())
+                throw Mesh::Exception ("Invalid OBJ face index.");
+
+    //bones et handles : on enlève la taille des vertices du mesh lus avant la ligne
+    for (size_t s = 0; s < infos.size (); s++) {
+        const SegmentInfo & info = infos[s];
+        const vector<Link> & links = info.segment->links;
+        for (size_t l = 0; l < links.size (); l++) {
+            const Link & link = links[l];
+            size_t before = info.objectVerticesBefore + (info.object ? link.localVertices : 0);
+            unsigned int index1 = link.index[0] - 1 - before;
+            unsigned int index2 = link.index[1] - 1 - before;
+            if (index1 >= vertices_bones.size () || index2 >= vertices_bones.size ())
+                throw Mesh::Exception ("Invalid OBJ bone index.");
+            if (link.handle) {
+                Handle * handle = new Handle (index1);
+                handle->buildBox (vertices_bones[index1]);
+                bones.push_back (handle);
+            } else {
+                Bone * bone = new Bone (index1, index2);
+                bone->buildBox (vertices_bones[index1], vertices_bones[index2]);
+                bones.push_back (bone);
+            }
+        }
+    }
+}
@@ -0,0 +1,67 @@
+//
+//  ObjParser.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 21/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__ObjParser__
+#define __Projet__ObjParser__
+
+#include <vector>
+#include <string>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class Armature;
+class MappedFile;
+
+class ObjParser {
+    //lecture d'un .obj en parallèle : le fichier est découpé en morceaux alignés sur les lignes,
+    //chaque morceau est lu par un thread dans son propre buffer, puis les buffers sont fusionnés
+    //dans l'ordre du fichier.
+    //on garde la sémantique de Mesh::loadOBJ : "o" -> vertices du mesh, "s" -> vertices du squelette,
+    //"l" -> bone, "lv" -> handle, avec des index décalés de vertices.size() au moment de la ligne.
+public:
+    ObjParser ();
+    virtual ~ObjParser () {}
+
+    inline void setNbThreads (unsigned int n) { nbThreads = n; }
+    inline unsigned int getNbThreads () const { return nbThreads; }
+
+    void parse (const MappedFile & file,
+                std::vector<Vertex> & vertices,
+                std::vector<Triangle> & triangles,
+                std::vector<Vertex> & vertices_bones,
+                std::vector<Armature *> & bones) const;
+
+    //un morceau en dessous de cette taille n'est pas découpé (le coût d'un thread n'est pas rentable)
+    static const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+    //une ligne "l" ou "lv" : index bruts du fichier, et nombre de "v" lus avant elle dans le segment
+    struct Link {
+        unsigned int index[2];
+        unsigned int localVertices;
+        bool handle;
+    };
+
+    //suite de lignes entre deux changements de mode ("o" ou "s")
+    struct Segment {
+        Segment (int m = -1) : mode (m) {}
+        int mode; // -1 : hérite du segment précédent, 0 : squelette, 1 : objet
+        std::vector<float> positions;
+        std::vector<unsigned int> faces; // triangles, index bruts (commencent à 1)
+        std::vector<Link> links;
+    };
+
+    typedef std::vector<Segment> Chunk;
+
+    static void parseChunk (const char * begin, const char * end, Chunk & chunk);
+
+private:
+    unsigned int nbThreads;
+};
+
+#endif /* defined(__Projet__ObjParser__) */
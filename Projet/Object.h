@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
 #include "Mesh.h"
 #include "BoundingBox.h"
@@ -23,6 +24,12 @@ public:
     }
     virtual ~Object () {}
 
+    inline void swap (Object & o) {
+        mesh.swap (o.mesh);
+        std::swap (bbox, o.bbox);
+        std::swap (trans, o.trans);
+    }
+
     inline const Vec3Df & getTrans () const { return trans;}
     inline void setTrans (const Vec3Df & t) { trans = t; }
 
@@ -0,0 +1,113 @@
+//
+//  OffReader.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 26/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "OffReader.h"
+#include "TextScanner.h"
+#include "Mesh.h"
+
+#include <cstring>
+
+using namespace std;
+
+void OffReader::open (const string & filename) {
+    if (!file.open (filename))
+        throw Mesh::Exception ("Failing opening the file.");
+    TextScanner scanner (file.data (), file.end ());
+    const char * magic_word;
+    size_t magic_size;
+    scanner.skipSpacesAndComments ();
+    if (!scanner.readWord (magic_word, magic_size) || magic_size != 3 || strncmp (magic_word, "OFF", 3) != 0)
+        throw Mesh::Exception ("Not an OFF file.");
+    unsigned int numOfWhat;
+    scanner.skipSpacesAndComments ();
+    if (!scanner.readUInt (nbVertices) || !scanner.readUInt (nbFaces) || !scanner.readUInt (numOfWhat))
+        throw Mesh::Exception ("Invalid OFF header.");
+    scanner.skipLine ();
+    verticesBegin = scanner.position ();
+    facesBegin = NULL;
+}
+
+void OffReader::readVertices (vector<Vertex> & vertices) {
+    TextScanner scanner (verticesBegin, file.end ());
+    //on connait les tailles grâce à l'en-tête : une seule allocation
+    vertices.reserve (vertices.size () + nbVertices);
+    for (unsigned int i = 0; i < nbVertices; i++) {
+        Vec3Df pos;
+        scanner.skipSpacesAndComments ();
+        if (!scanner.readFloat (pos[0]) || !scanner.readFloat (pos[1]) || !scanner.readFloat (pos[2]))
+            throw Mesh::Exception ("Invalid OFF vertex.");
+        //on ignore une éventuelle couleur en fin de ligne
+        scanner.skipLine ();
+        vertices.push_back (Vertex (pos, Vec3Df (1.0, 0.0, 0.0)));
+    }
+    facesBegin = scanner.position ();
+}
+
+//une face "n i0 i1 ... [couleur]" triangulée en éventail sans tableau temporaire : (first, previous, current)
+static inline bool readFace (TextScanner & scanner, unsigned int nbVertices, vector<Triangle> & triangles) {
+    unsigned int polygonSize;
+    size_t start = triangles.size ();
+    unsigned int first, previous, current;
+    if (!scanner.readUInt (polygonSize) || polygonSize < 3 || !scanner.readUInt (first) || !scanner.readUInt (previous))
+        return false;
+    for (unsigned int j = 2; j < polygonSize; j++) {
+        if (!scanner.readUInt (current)) {
+            triangles.resize (start);
+            return false;
+        }
+        triangles.push_back (Triangle (first, previous, current));
+        previous = current;
+    }
+    //on ignore une éventuelle couleur de face
+    scanner.skipLine ();
+    if (first >= nbVertices || previous >= nbVertices)
+        throw Mesh::Exception ("Invalid OFF vertex index.");
+    for (size_t i = start; i < triangles.size (); i++)
+        if (triangles[i].getVertex (1) >= nbVertices)
+            throw Mesh::Exception ("Invalid OFF vertex index.");
+    return true;
+}
+
+void OffReader::readFaces (vector<Triangle> & triangles) const {
+    if (facesBegin == NULL)
+        throw Mesh::Exception ("OFF vertices not read.");
+    TextScanner scanner (facesBegin, file.end ());
+    triangles.reserve (triangles.size () + nbFaces);
+    for (unsigned int i = 0; i < nbFaces; i++) {
+        scanner.skipSpacesAndComments ();
+        if (!readFace (scanner, nbVertices, triangles))
+            throw Mesh::Exception ("Invalid OFF face.");
+    }
+}
+
+void OffReader::sampleFaces (unsigned int nbSamples, vector<Triangle> & triangles) const {
+    if (facesBegin == NULL)
+        throw Mesh::Exception ("OFF vertices not read.");
+    if (nbSamples >= nbFaces) {
+        readFaces (triangles);
+        return;
+    }
+    size_t length = file.end () - facesBegin;
+    const char * previousLine = NULL;
+    for (unsigned int i = 0; i < nbSamples; i++) {
+        //milieu du i-ème intervalle, puis début de la ligne suivante (sauf si on y est déjà)
+        const char * p = facesBegin + (2 * size_t (i) + 1) * length / (2 * size_t (nbSamples));
+        if (p > facesBegin && p[-1] != '\n') {
+            const char * eol = static_cast<const char *> (memchr (p, '\n', file.end () - p));
+            if (eol == NULL)
+                break;
+            p = eol + 1;
+        }
+        TextScanner scanner (p, file.end ());
+        scanner.skipSpacesAndComments ();
+        if (scanner.position () == previousLine)
+            continue;
+        previousLine = scanner.position ();
+        readFace (scanner, nbVertices, triangles);
+    }
+}
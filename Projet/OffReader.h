@@ -0,0 +1,48 @@
+//
+//  OffReader.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 26/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__OffReader__
+#define __Projet__OffReader__
+
+#include <vector>
+#include <string>
+
+#include "MappedFile.h"
+#include "Vertex.h"
+#include "Triangle.h"
+
+class OffReader {
+    //lecture d'un .off en plusieurs temps, sur le fichier projeté en mémoire :
+    //en-tête, puis vertices, puis faces (toutes, ou seulement un échantillon pour un aperçu).
+    //Mesh::loadOFF enchaîne open, readVertices et readFaces.
+public:
+    inline OffReader () : nbVertices (0), nbFaces (0), facesBegin (NULL) {}
+    virtual ~OffReader () {}
+
+    //lit l'en-tête, lève Mesh::Exception
+    void open (const std::string & filename);
+
+    inline unsigned int getNbVertices () const { return nbVertices; }
+    inline unsigned int getNbFaces () const { return nbFaces; }
+    inline size_t getFileSize () const { return file.size (); }
+
+    void readVertices (std::vector<Vertex> & vertices);
+    //toutes les faces, triangulées en éventail
+    void readFaces (std::vector<Triangle> & triangles) const;
+    //environ nbSamples faces prises à intervalles réguliers dans le bloc des faces : seules les
+    //pages du fichier qui contiennent ces faces sont lues
+    void sampleFaces (unsigned int nbSamples, std::vector<Triangle> & triangles) const;
+
+private:
+    MappedFile file;
+    unsigned int nbVertices, nbFaces;
+    const char * verticesBegin;
+    const char * facesBegin;
+};
+
+#endif /* defined(__Projet__OffReader__) */
@@ -0,0 +1,332 @@
+//
+//  PoseTimeline.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "PoseTimeline.h"
+#include "Skinning.h"
+#include "Mesh.h"
+
+#include <cmath>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+typedef float Matrix3[3][3];
+
+struct Rotation {
+    Matrix3 m;
+};
+
+static void identity (Matrix3 R) {
+    for (unsigned int i = 0; i < 3; i++)
+        for (unsigned int j = 0; j < 3; j++)
+            R[i][j] = (i == j) ? 1.f : 0.f;
+}
+
+static void multiply (const Matrix3 A, const Matrix3 B, Matrix3 C) {
+    Matrix3 tmp;
+    for (unsigned int i = 0; i < 3; i++)
+        for (unsigned int j = 0; j < 3; j++)
+            tmp[i][j] = A[i][0] * B[0][j] + A[i][1] * B[1][j] + A[i][2] * B[2][j];
+    copy (&tmp[0][0], &tmp[0][0] + 9, &C[0][0]);
+}
+
+static Vec3Df multiply (const Matrix3 A, const Vec3Df & v) {
+    return Vec3Df (A[0][0] * v[0] + A[0][1] * v[1] + A[0][2] * v[2],
+                   A[1][0] * v[0] + A[1][1] * v[1] + A[1][2] * v[2],
+                   A[2][0] * v[0] + A[2][1] * v[1] + A[2][2] * v[2]);
+}
+
+//quaternion x y z w -> transformation 3x4 (cf Skinning::TRANSFORM_SIZE)
+static void toTransform (const float q[4], const float t[3], float * m) {
+    const float x = q[0], y = q[1], z = q[2], w = q[3];
+    const float R[3][3] = {{1 - 2 * (y * y + z * z), 2 * (x * y - w * z), 2 * (x * z + w * y)},
+                           {2 * (x * y + w * z), 1 - 2 * (x * x + z * z), 2 * (y * z - w * x)},
+                           {2 * (x * z - w * y), 2 * (y * z + w * x), 1 - 2 * (x * x + y * y)}};
+    for (unsigned int r = 0; r < 3; r++) {
+        m[4*r] = R[r][0];
+        m[4*r + 1] = R[r][1];
+        m[4*r + 2] = R[r][2];
+        m[4*r + 3] = t[r];
+    }
+}
+
+static void slerp (const float a[4], const float b[4], float u, float q[4]) {
+    float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    float sign = 1.f;
+    if (dot < 0) {
+        //q et -q : même rotation, on prend le plus court chemin
+        dot = -dot;
+        sign = -1.f;
+    }
+    float wa = 1.f - u, wb = u;
+    if (dot < 0.9995f) {
+        float angle = acos (dot);
+        float s = sin (angle);
+        wa = sin ((1.f - u) * angle) / s;
+        wb = sin (u * angle) / s;
+    }
+    float length = 0;
+    for (unsigned int e = 0; e < 4; e++) {
+        q[e] = wa * a[e] + sign * wb * b[e];
+        length += q[e] * q[e];
+    }
+    length = sqrt (length);
+    for (unsigned int e = 0; e < 4; e++)
+        q[e] /= length;
+}
+
+void PoseTimeline::clear () {
+    tracks.clear ();
+    frameTime = 0.f;
+}
+
+void PoseTimeline::setNbBones (unsigned int n) {
+    tracks.resize (n);
+}
+
+float PoseTimeline::getDuration () const {
+    float duration = 0.f;
+    for (unsigned int b = 0; b < tracks.size (); b++)
+        if (!tracks[b].empty ())
+            duration = max (duration, tracks[b].back ().time);
+    return duration;
+}
+
+static bool keyBefore (const PoseTimeline::Key & key, float time) {
+    return key.time < time;
+}
+
+void PoseTimeline::addKey (unsigned int bone, float time, const float * m) {
+    if (bone >= tracks.size ())
+        tracks.resize (bone + 1);
+    Key key;
+    key.time = time;
+    float q[Skinning::TRANSFORM_SIZE];
+    Skinning::toQuaternions (m, 1, q);
+    copy (q, q + 4, key.rotation);
+    key.translation[0] = m[3];
+    key.translation[1] = m[7];
+    key.translation[2] = m[11];
+
+    vector<Key> & track = tracks[bone];
+    vector<Key>::iterator it = lower_bound (track.begin (), track.end (), time, keyBefore);
+    if (it != track.end () && it->time == time)
+        *it = key;
+    else
+        track.insert (it, key);
+}
+
+void PoseTimeline::evaluate (float time, float * transforms) const {
+    for (unsigned int b = 0; b < tracks.size (); b++) {
+        float * m = transforms + Skinning::TRANSFORM_SIZE * b;
+        const vector<Key> & track = tracks[b];
+        if (track.empty ()) {
+            const float q[4] = {0, 0, 0, 1}, t[3] = {0, 0, 0};
+            toTransform (q, t, m);
+            continue;
+        }
+        vector<Key>::const_iterator it = lower_bound (track.begin (), track.end (), time, keyBefore);
+        if (it == track.begin () || it == track.end ()) {
+            const Key & key = (it == track.end ()) ? track.back () : track.front ();
+            toTransform (key.rotation, key.translation, m);
+            continue;
+        }
+        const Key & k0 = *(it - 1);
+        const Key & k1 = *it;
+        float u = (time - k0.time) / (k1.time - k0.time);
+        float q[4], t[3];
+        slerp (k0.rotation, k1.rotation, u, q);
+        for (unsigned int c = 0; c < 3; c++)
+            t[c] = (1.f - u) * k0.translation[c] + u * k1.translation[c];
+        toTransform (q, t, m);
+    }
+}
+
+//joint d'un fichier BVH
+struct BVHJoint {
+    BVHJoint () : parent (-1), firstChannel (0) {}
+    int parent;
+    Vec3Df offset;
+    std::vector<int> channels;  // 0..2 : position X Y Z, 3..5 : rotation X Y Z
+    unsigned int firstChannel;
+};
+
+static string nextToken (ifstream & in) {
+    string token;
+    if (!(in >> token))
+        throw Mesh::Exception ("Truncated BVH file.");
+    return token;
+}
+
+static float nextFloat (ifstream & in) {
+    float f;
+    if (!(in >> f))
+        throw Mesh::Exception ("Invalid BVH number.");
+    return f;
+}
+
+static void expect (ifstream & in, const string & expected) {
+    if (nextToken (in) != expected)
+        throw Mesh::Exception ("Invalid BVH file : " + expected + " expected.");
+}
+
+//lit un joint (après ROOT/JOINT) et ses enfants, dans l'ordre du fichier ; les End Site ne donnent que
+//leur position par rapport à leur joint (pour la taille du squelette au repos)
+static void parseJoint (ifstream & in, int parent, vector<BVHJoint> & joints,
+                        vector<pair<unsigned int, Vec3Df> > & endSites, unsigned int & nbChannels) {
+    nextToken (in); // nom
+    expect (in, "{");
+    unsigned int index = joints.size ();
+    joints.push_back (BVHJoint ());
+    joints[index].parent = parent;
+    for (string token = nextToken (in); token != "}"; token = nextToken (in)) {
+        if (token == "OFFSET") {
+            for (unsigned int c = 0; c < 3; c++)
+                joints[index].offset[c] = nextFloat (in);
+        } else if (token == "CHANNELS") {
+            int n = int (nextFloat (in));
+            joints[index].firstChannel = nbChannels;
+            for (int i = 0; i < n; i++) {
+                string name = nextToken (in);
+                if (name.size () != 9 || name[0] < 'X' || name[0] > 'Z')
+                    throw Mesh::Exception ("Invalid BVH channel " + name + ".");
+                int axis = name[0] - 'X';
+                if (name.compare (1, 8, "position") == 0)
+                    joints[index].channels.push_back (axis);
+                else if (name.compare (1, 8, "rotation") == 0)
+                    joints[index].channels.push_back (3 + axis);
+                else
+                    throw Mesh::Exception ("Invalid BVH channel " + name + ".");
+            }
+            nbChannels += n;
+        } else if (token == "JOINT") {
+            parseJoint (in, index, joints, endSites, nbChannels);
+        } else if (token == "End") {
+            expect (in, "Site");
+            expect (in, "{");
+            expect (in, "OFFSET");
+            Vec3Df end;
+            for (unsigned int c = 0; c < 3; c++)
+                end[c] = nextFloat (in);
+            expect (in, "}");
+            endSites.push_back (make_pair (index, end));
+        } else {
+            throw Mesh::Exception ("Invalid BVH token " + token + ".");
+        }
+    }
+}
+
+static float diagonal (const vector<Vec3Df> & points) {
+    if (points.empty ())
+        return 0.f;
+    Vec3Df lo = points[0], hi = points[0];
+    for (unsigned int i = 1; i < points.size (); i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            lo[c] = min (lo[c], points[i][c]);
+            hi[c] = max (hi[c], points[i][c]);
+        }
+    return (hi - lo).getLength ();
+}
+
+void PoseTimeline::loadBVH (const string & filename, const vector<Vertex> & vertices_bones,
+                            const vector<Armature *> & bones) {
+    ifstream in (filename.c_str ());
+    if (!in)
+        throw Mesh::Exception ("Failing opening the file " + filename + ".");
+
+    expect (in, "HIERARCHY");
+    expect (in, "ROOT");
+    vector<BVHJoint> joints;
+    vector<pair<unsigned int, Vec3Df> > endSites;
+    unsigned int nbChannels = 0;
+    parseJoint (in, -1, joints, endSites, nbChannels);
+    //positions au repos (tous les canaux à 0) des joints puis des End Sites
+    vector<Vec3Df> restJoints (joints.size ());
+    for (unsigned int j = 0; j < joints.size (); j++)
+        restJoints[j] = ((joints[j].parent < 0) ? Vec3Df (0, 0, 0) : restJoints[joints[j].parent]) + joints[j].offset;
+    vector<Vec3Df> restPoints (restJoints);
+    for (unsigned int i = 0; i < endSites.size (); i++)
+        restPoints.push_back (restJoints[endSites[i].first] + endSites[i].second);
+
+    expect (in, "MOTION");
+    expect (in, "Frames:");
+    int nbFrames = int (nextFloat (in));
+    expect (in, "Frame");
+    expect (in, "Time:");
+    float time = nextFloat (in);
+    if (nbFrames < 0 || time <= 0)
+        throw Mesh::Exception ("Invalid BVH motion.");
+
+    vector<Vec3Df> skeleton (vertices_bones.size ());
+    for (unsigned int i = 0; i < vertices_bones.size (); i++)
+        skeleton[i] = vertices_bones[i].getPos ();
+    float bvhSize = diagonal (restPoints);
+    float scale = (bvhSize > 0 && !skeleton.empty ()) ? diagonal (skeleton) / bvhSize : 1.f;
+
+    clear ();
+    frameTime = time;
+    setNbBones (bones.size ());
+    unsigned int nbAnimated = min (joints.size (), bones.size ());
+    for (unsigned int b = 0; b < nbAnimated; b++)
+        tracks[b].reserve (nbFrames);
+
+    vector<float> values (nbChannels);
+    vector<Vec3Df> positions (joints.size ());
+    vector<Rotation> rotations (joints.size ());
+    for (int f = 0; f < nbFrames; f++) {
+        for (unsigned int c = 0; c < nbChannels; c++)
+            values[c] = nextFloat (in);
+        //rotation et position globales de chaque joint (les parents sont avant leurs enfants)
+        for (unsigned int j = 0; j < joints.size (); j++) {
+            const BVHJoint & joint = joints[j];
+            Vec3Df local = joint.offset;
+            Matrix3 R;
+            identity (R);
+            for (unsigned int c = 0; c < joint.channels.size (); c++) {
+                float v = values[joint.firstChannel + c];
+                int channel = joint.channels[c];
+                if (channel < 3) {
+                    local[channel] += v;
+                    continue;
+                }
+                //rotations dans l'ordre des canaux, en degrés
+                float angle = v * float (M_PI) / 180.f;
+                float cs = cos (angle), sn = sin (angle);
+                Matrix3 A;
+                identity (A);
+                int a = (channel - 3 + 1) % 3, b = (channel - 3 + 2) % 3;
+                A[a][a] = cs; A[a][b] = -sn;
+                A[b][a] = sn; A[b][b] = cs;
+                multiply (R, A, R);
+            }
+            if (joint.parent < 0) {
+                copy (&R[0][0], &R[0][0] + 9, &rotations[j].m[0][0]);
+                positions[j] = local;
+            } else {
+                const Rotation & P = rotations[joint.parent];
+                multiply (P.m, R, rotations[j].m);
+                positions[j] = positions[joint.parent] + multiply (P.m, local);
+            }
+        }
+        //bone b : p' = G (p - a0) + a0 + scale (P - P0)
+        for (unsigned int b = 0; b < nbAnimated; b++) {
+            const Matrix3 & G = rotations[b].m;
+            Vec3Df a0 = skeleton[bones[b]->getVertex (0)];
+            Vec3Df t = a0 - multiply (G, a0) + scale * (positions[b] - restJoints[b]);
+            float m[Skinning::TRANSFORM_SIZE];
+            for (unsigned int r = 0; r < 3; r++) {
+                m[4*r] = G[r][0];
+                m[4*r + 1] = G[r][1];
+                m[4*r + 2] = G[r][2];
+                m[4*r + 3] = t[r];
+            }
+            addKey (b, f * time, m);
+        }
+    }
+}
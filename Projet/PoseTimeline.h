@@ -0,0 +1,61 @@
+//
+//  PoseTimeline.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__PoseTimeline__
+#define __Projet__PoseTimeline__
+
+#include <vector>
+#include <string>
+
+#include "Vertex.h"
+
+class Armature;
+
+class PoseTimeline {
+    //animation du squelette : pour chaque bone de Mesh::bones, une suite de clés (temps, rotation, translation).
+    //la transformation d'un bone est celle de Skinning (pose de repos -> pose animée, p' = R p + t) ;
+    //entre deux clés la rotation est interpolée en slerp et la translation linéairement, avant la première
+    //et après la dernière clé le bone garde la pose de la clé. Un bone sans clé reste au repos.
+public:
+    struct Key {
+        float time;
+        float rotation[4];      // quaternion unitaire x y z w
+        float translation[3];
+    };
+
+    PoseTimeline () : frameTime (0.f) {}
+
+    void clear ();
+    void setNbBones (unsigned int n);
+    inline unsigned int getNbBones () const { return tracks.size (); }
+    inline unsigned int getNbKeys (unsigned int bone) const { return tracks[bone].size (); }
+    inline const Key & getKey (unsigned int bone, unsigned int k) const { return tracks[bone][k]; }
+    //temps de la dernière clé
+    float getDuration () const;
+    //intervalle entre deux images du fichier importé (0 si les clés ont été ajoutées à la main)
+    inline float getFrameTime () const { return frameTime; }
+
+    //m : transformation rigide (Skinning::TRANSFORM_SIZE floats) ; une clé au même instant est remplacée
+    void addKey (unsigned int bone, float time, const float * m);
+    //transformations de tous les bones à l'instant time (Skinning::TRANSFORM_SIZE floats par bone)
+    void evaluate (float time, float * transforms) const;
+
+    //import d'un fichier BVH (hiérarchie puis une pose par image) : une clé par image et par bone.
+    //les joints sont associés aux bones dans l'ordre du fichier (le joint i anime le bone i, les bones en trop
+    //restent au repos). Un bone tourne autour de son premier vertex comme le joint autour de son origine,
+    //et se déplace comme le joint, à l'échelle du squelette (rapport des tailles des deux squelettes au repos).
+    //on suppose les mêmes axes que le mesh. Lève Mesh::Exception si le fichier est invalide.
+    void loadBVH (const std::string & filename, const std::vector<Vertex> & vertices_bones,
+                  const std::vector<Armature *> & bones);
+
+private:
+    std::vector<std::vector<Key> > tracks;
+    float frameTime;
+};
+
+#endif /* defined(__Projet__PoseTimeline__) */
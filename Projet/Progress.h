@@ -0,0 +1,53 @@
+//
+//  Progress.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 25/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__Progress__
+#define __Projet__Progress__
+
+#include <string>
+#include <mutex>
+#include <atomic>
+
+class Progress {
+    //avancement d'un calcul fait dans un autre thread : le calcul appelle set() entre deux étapes,
+    //l'interface lit l'avancement avec get() et peut demander l'annulation avec cancel().
+    //set() lève Progress::Cancelled quand l'annulation a été demandée.
+public:
+    class Cancelled {};
+
+    inline Progress () : cancelled (false), fraction (0.f) {}
+    virtual ~Progress () {}
+
+    inline void cancel () { cancelled = true; }
+    inline bool isCancelled () const { return cancelled; }
+
+    inline void set (const std::string & s, float f) {
+        if (cancelled)
+            throw Cancelled ();
+        std::lock_guard<std::mutex> lock (mutex);
+        step = s;
+        fraction = f;
+    }
+
+    inline void get (std::string & s, float & f) const {
+        std::lock_guard<std::mutex> lock (mutex);
+        s = step;
+        f = fraction;
+    }
+
+private:
+    Progress (const Progress &);
+    Progress & operator= (const Progress &);
+
+    std::atomic<bool> cancelled;
+    mutable std::mutex mutex;
+    std::string step;
+    float fraction;
+};
+
+#endif /* defined(__Projet__Progress__) */
@@ -0,0 +1,526 @@
+//
+//  Skinning.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "Skinning.h"
+#include "InfluenceTable.h"
+#include "Armature.h"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef SKINNING_AVX2
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+const unsigned int Skinning::LANES;
+const unsigned int Skinning::TRANSFORM_SIZE;
+const unsigned int Skinning::EVALUATE_CHUNK;
+
+static inline unsigned int padded (unsigned int n) {
+    return (n + Skinning::LANES - 1) / Skinning::LANES * Skinning::LANES;
+}
+
+void Skinning::clear () {
+    nbVertices = nbBones = nbInfluences = 0;
+    for (unsigned int c = 0; c < 3; c++) {
+        rest[c].clear ();
+        restNormals[c].clear ();
+        posed[c].clear ();
+        posedNormals[c].clear ();
+    }
+    offsets.clear ();
+    weights.clear ();
+    transforms.clear ();
+    quaternions.clear ();
+    restBones.clear ();
+    boneVertexStart.clear ();
+    boneVertexIndices.clear ();
+    dirty.clear ();
+    blockStamp.clear ();
+    blocks.clear ();
+    stamp = 0;
+}
+
+void Skinning::swap (Skinning & skinning) {
+    std::swap (mode, skinning.mode);
+    std::swap (nbVertices, skinning.nbVertices);
+    std::swap (nbBones, skinning.nbBones);
+    std::swap (nbInfluences, skinning.nbInfluences);
+    for (unsigned int c = 0; c < 3; c++) {
+        rest[c].swap (skinning.rest[c]);
+        restNormals[c].swap (skinning.restNormals[c]);
+        posed[c].swap (skinning.posed[c]);
+        posedNormals[c].swap (skinning.posedNormals[c]);
+    }
+    offsets.swap (skinning.offsets);
+    weights.swap (skinning.weights);
+    transforms.swap (skinning.transforms);
+    quaternions.swap (skinning.quaternions);
+    restBones.swap (skinning.restBones);
+    boneVertexStart.swap (skinning.boneVertexStart);
+    boneVertexIndices.swap (skinning.boneVertexIndices);
+    dirty.swap (skinning.dirty);
+    blockStamp.swap (skinning.blockStamp);
+    blocks.swap (skinning.blocks);
+    std::swap (stamp, skinning.stamp);
+}
+
+void Skinning::bind (const vector<Vertex> & vertices, const vector<Vertex> & vertices_bones,
+                     const vector<Armature *> & bones, const InfluenceTable & influences) {
+    clear ();
+    if (bones.empty () || influences.getNbVertices () != vertices.size () || influences.getNbBones () != bones.size ())
+        return;
+    nbVertices = vertices.size ();
+    nbBones = bones.size ();
+    nbInfluences = InfluenceTable::K;
+    const unsigned int n = padded (nbVertices);
+
+    for (unsigned int c = 0; c < 3; c++) {
+        rest[c].assign (n, 0.f);
+        restNormals[c].assign (n, 0.f);
+        posed[c].assign (n, 0.f);
+        posedNormals[c].assign (n, 0.f);
+    }
+    for (unsigned int i = 0; i < nbVertices; i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            rest[c][i] = vertices[i].getPos ()[c];
+            restNormals[c][i] = vertices[i].getNormal ()[c];
+        }
+
+    setInfluences (influences);
+    blockStamp.assign (n / LANES, 0);
+
+    restBones.resize (vertices_bones.size ());
+    for (unsigned int i = 0; i < vertices_bones.size (); i++)
+        restBones[i] = vertices_bones[i].getPos ();
+    //les vertices sont dans la pose de repos : rien à recalculer
+    resetTransforms ();
+    dirty.assign (nbBones, 0);
+}
+
+void Skinning::setInfluences (const InfluenceTable & influences) {
+    if (influences.getNbVertices () != nbVertices || influences.getNbBones () != nbBones)
+        return;
+    const unsigned int n = padded (nbVertices);
+    //une entrée inutilisée pointe sur le bone 0 avec un poids nul
+    offsets.assign (nbInfluences * n, 0);
+    weights.assign (nbInfluences * n, 0.f);
+    for (unsigned int i = 0; i < nbVertices; i++)
+        for (unsigned int k = 0; k < nbInfluences; k++) {
+            uint16_t bone = influences.getBone (i, k);
+            if (bone == InfluenceTable::NO_BONE)
+                continue;
+            offsets[k * n + i] = int32_t (bone) * TRANSFORM_SIZE;
+            weights[k * n + i] = influences.getWeight (i, k);
+        }
+
+    //listes des vertices de chaque bone (tri par comptage)
+    boneVertexStart.assign (nbBones + 1, 0);
+    for (unsigned int i = 0; i < nbVertices; i++)
+        for (unsigned int k = 0; k < nbInfluences; k++)
+            if (weights[k * n + i] != 0)
+                boneVertexStart[offsets[k * n + i] / TRANSFORM_SIZE + 1]++;
+    for (unsigned int b = 0; b < nbBones; b++)
+        boneVertexStart[b + 1] += boneVertexStart[b];
+    boneVertexIndices.resize (boneVertexStart[nbBones]);
+    vector<unsigned int> next (boneVertexStart.begin (), boneVertexStart.end () - 1);
+    for (unsigned int i = 0; i < nbVertices; i++)
+        for (unsigned int k = 0; k < nbInfluences; k++)
+            if (weights[k * n + i] != 0)
+                boneVertexIndices[next[offsets[k * n + i] / TRANSFORM_SIZE]++] = i;
+    //même pose de repos, autres poids : tous les vertices sont à recalculer
+    dirty.assign (nbBones, 1);
+}
+
+void Skinning::resetTransforms () {
+    for (unsigned int b = 0; b < nbBones; b++) {
+        float m[TRANSFORM_SIZE] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+        setTransform (b, m);
+    }
+}
+
+void Skinning::setTransform (unsigned int bone, const float m[TRANSFORM_SIZE]) {
+    if (transforms.size () != TRANSFORM_SIZE * nbBones)
+        transforms.assign (TRANSFORM_SIZE * nbBones, 0.f);
+    if (dirty.size () != nbBones)
+        dirty.assign (nbBones, 1);
+    float * t = &transforms[TRANSFORM_SIZE * bone];
+    if (equal (m, m + TRANSFORM_SIZE, t))
+        return;
+    copy (m, m + TRANSFORM_SIZE, t);
+    dirty[bone] = 1;
+}
+
+//rotation minimale qui amène la direction u sur la direction v (unitaires), en ligne
+static void rotationBetween (const Vec3Df & u, const Vec3Df & v, float R[3][3]) {
+    Vec3Df axis = Vec3Df::crossProduct (u, v);
+    float c = Vec3Df::dotProduct (u, v);
+    if (c < -1.f + 1e-6f) {
+        //demi-tour : rotation de pi autour d'un axe orthogonal à u
+        Vec3Df x, y;
+        u.getTwoOrthogonals (x, y);
+        x.normalize ();
+        for (unsigned int i = 0; i < 3; i++)
+            for (unsigned int j = 0; j < 3; j++)
+                R[i][j] = 2.f * x[i] * x[j] - (i == j ? 1.f : 0.f);
+        return;
+    }
+    //Rodrigues : R = I + [a]x + [a]x^2 / (1 + c)
+    float K[3][3] = {{0, -axis[2], axis[1]}, {axis[2], 0, -axis[0]}, {-axis[1], axis[0], 0}};
+    float f = 1.f / (1.f + c);
+    for (unsigned int i = 0; i < 3; i++)
+        for (unsigned int j = 0; j < 3; j++) {
+            float K2 = 0;
+            for (unsigned int l = 0; l < 3; l++)
+                K2 += K[i][l] * K[l][j];
+            R[i][j] = (i == j ? 1.f : 0.f) + K[i][j] + f * K2;
+        }
+}
+
+void Skinning::setPose (const vector<Vertex> & vertices_bones, const vector<Armature *> & bones) {
+    if (bones.size () != nbBones || vertices_bones.size () != restBones.size ())
+        return;
+    for (unsigned int b = 0; b < nbBones; b++) {
+        Vec3Df a0 = restBones[bones[b]->getVertex (0)];
+        Vec3Df a1 = vertices_bones[bones[b]->getVertex (0)].getPos ();
+        float R[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+        if (bones[b]->getType () == "bone") {
+            Vec3Df u = restBones[bones[b]->getVertex (1)] - a0;
+            Vec3Df v = vertices_bones[bones[b]->getVertex (1)].getPos () - a1;
+            if (u.getSquaredLength () > 0 && v.getSquaredLength () > 0) {
+                u.normalize ();
+                v.normalize ();
+                rotationBetween (u, v, R);
+            }
+        }
+        //p' = R (p - a0) + a1
+        float m[TRANSFORM_SIZE];
+        for (unsigned int r = 0; r < 3; r++) {
+            m[4*r] = R[r][0];
+            m[4*r + 1] = R[r][1];
+            m[4*r + 2] = R[r][2];
+            m[4*r + 3] = a1[r] - (R[r][0] * a0[0] + R[r][1] * a0[1] + R[r][2] * a0[2]);
+        }
+        setTransform (b, m);
+    }
+}
+
+void Skinning::updateQuaternions () {
+    quaternions.assign (TRANSFORM_SIZE * nbBones, 0.f);
+    toQuaternions (transforms.data (), nbBones, quaternions.data ());
+}
+
+//quaternion dual unitaire de chaque transformation (rotation R, translation t) :
+//réel r = quaternion de R, dual d = 1/2 (t, 0) r
+void Skinning::toQuaternions (const float * transforms, unsigned int nbBones, float * quaternions) {
+    for (unsigned int b = 0; b < nbBones; b++) {
+        const float * m = &transforms[TRANSFORM_SIZE * b];
+        float * q = &quaternions[TRANSFORM_SIZE * b];
+        const float m00 = m[0], m01 = m[1], m02 = m[2], m10 = m[4], m11 = m[5], m12 = m[6], m20 = m[8], m21 = m[9], m22 = m[10];
+        float trace = m00 + m11 + m22;
+        if (trace > 0) {
+            float f = 2.f * sqrt (trace + 1.f);
+            q[0] = (m21 - m12) / f; q[1] = (m02 - m20) / f; q[2] = (m10 - m01) / f; q[3] = 0.25f * f;
+        } else if (m00 > m11 && m00 > m22) {
+            float f = 2.f * sqrt (1.f + m00 - m11 - m22);
+            q[0] = 0.25f * f; q[1] = (m01 + m10) / f; q[2] = (m02 + m20) / f; q[3] = (m21 - m12) / f;
+        } else if (m11 > m22) {
+            float f = 2.f * sqrt (1.f + m11 - m00 - m22);
+            q[0] = (m01 + m10) / f; q[1] = 0.25f * f; q[2] = (m12 + m21) / f; q[3] = (m02 - m20) / f;
+        } else {
+            float f = 2.f * sqrt (1.f + m22 - m00 - m11);
+            q[0] = (m02 + m20) / f; q[1] = (m12 + m21) / f; q[2] = 0.25f * f; q[3] = (m10 - m01) / f;
+        }
+        float length = sqrt (q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (unsigned int e = 0; e < 4; e++)
+            q[e] /= length;
+        const float tx = m[3], ty = m[7], tz = m[11];
+        q[4] = 0.5f * (tx * q[3] + ty * q[2] - tz * q[1]);
+        q[5] = 0.5f * (-tx * q[2] + ty * q[3] + tz * q[0]);
+        q[6] = 0.5f * (tx * q[1] - ty * q[0] + tz * q[3]);
+        q[7] = -0.5f * (tx * q[0] + ty * q[1] + tz * q[2]);
+    }
+}
+
+void Skinning::deformScalar (const float * T, unsigned int begin, unsigned int end, float * const * out) const {
+    const unsigned int n = rest[0].size ();
+    for (unsigned int i = begin; i < end; i++) {
+        float m[TRANSFORM_SIZE] = {0};
+        for (unsigned int k = 0; k < nbInfluences; k++) {
+            const float w = weights[k * n + i];
+            const float * t = T + offsets[k * n + i];
+            for (unsigned int e = 0; e < TRANSFORM_SIZE; e++)
+                m[e] += w * t[e];
+        }
+        const float x = rest[0][i], y = rest[1][i], z = rest[2][i];
+        const float nx = restNormals[0][i], ny = restNormals[1][i], nz = restNormals[2][i];
+        float normal[3];
+        for (unsigned int r = 0; r < 3; r++) {
+            out[r][i - begin] = m[4*r] * x + m[4*r + 1] * y + m[4*r + 2] * z + m[4*r + 3];
+            //la normale suit la partie linéaire mélangée (rotations : pas besoin de l'inverse transposée)
+            normal[r] = m[4*r] * nx + m[4*r + 1] * ny + m[4*r + 2] * nz;
+        }
+        if (!out[3])
+            continue;
+        float length = sqrt (normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        float inv = (length > 0) ? 1.f / length : 0.f;
+        for (unsigned int r = 0; r < 3; r++)
+            out[3 + r][i - begin] = normal[r] * inv;
+    }
+}
+
+void Skinning::deformDQScalar (const float * Q, unsigned int begin, unsigned int end, float * const * out) const {
+    const unsigned int n = rest[0].size ();
+    for (unsigned int i = begin; i < end; i++) {
+        //les quaternions q et -q donnent la même rotation : on les aligne sur celui du premier bone
+        const float * q0 = Q + offsets[i];
+        float b[8] = {0};
+        for (unsigned int k = 0; k < nbInfluences; k++) {
+            const float * q = Q + offsets[k * n + i];
+            float w = weights[k * n + i];
+            if (q[0] * q0[0] + q[1] * q0[1] + q[2] * q0[2] + q[3] * q0[3] < 0)
+                w = -w;
+            for (unsigned int e = 0; e < 8; e++)
+                b[e] += w * q[e];
+        }
+        float length = sqrt (b[0] * b[0] + b[1] * b[1] + b[2] * b[2] + b[3] * b[3]);
+        float inv = (length > 0) ? 1.f / length : 0.f;
+        for (unsigned int e = 0; e < 8; e++)
+            b[e] *= inv;
+        //translation t = 2 (w_r d - w_d r + r x d), rotation v + 2 r x (r x v + w_r v)
+        const float t[3] = {2.f * (b[3] * b[4] - b[7] * b[0] + b[1] * b[6] - b[2] * b[5]),
+                            2.f * (b[3] * b[5] - b[7] * b[1] + b[2] * b[4] - b[0] * b[6]),
+                            2.f * (b[3] * b[6] - b[7] * b[2] + b[0] * b[5] - b[1] * b[4])};
+        float v[2][3] = {{rest[0][i], rest[1][i], rest[2][i]}, {restNormals[0][i], restNormals[1][i], restNormals[2][i]}};
+        for (unsigned int j = 0; j < (out[3] ? 2u : 1u); j++) {
+            float c[3] = {b[1] * v[j][2] - b[2] * v[j][1] + b[3] * v[j][0],
+                          b[2] * v[j][0] - b[0] * v[j][2] + b[3] * v[j][1],
+                          b[0] * v[j][1] - b[1] * v[j][0] + b[3] * v[j][2]};
+            v[j][0] += 2.f * (b[1] * c[2] - b[2] * c[1]);
+            v[j][1] += 2.f * (b[2] * c[0] - b[0] * c[2]);
+            v[j][2] += 2.f * (b[0] * c[1] - b[1] * c[0]);
+        }
+        for (unsigned int r = 0; r < 3; r++) {
+            out[r][i - begin] = v[0][r] + t[r];
+            if (out[3])
+                out[3 + r][i - begin] = v[1][r];
+        }
+    }
+}
+
+#ifdef SKINNING_AVX2
+//8 vertices à la fois ; les 12 coefficients de chaque bone sont lus par gather (même index, base décalée)
+__attribute__ ((target ("avx2,fma")))
+void Skinning::deformAVX2 (const float * T, unsigned int begin, unsigned int end, float * const * out) const {
+    const unsigned int n = rest[0].size ();
+    for (unsigned int i = begin; i < end; i += LANES) {
+        __m256 m[TRANSFORM_SIZE];
+        for (unsigned int e = 0; e < TRANSFORM_SIZE; e++)
+            m[e] = _mm256_setzero_ps ();
+        for (unsigned int k = 0; k < nbInfluences; k++) {
+            const __m256 w = _mm256_loadu_ps (&weights[k * n + i]);
+            const __m256i offset = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (&offsets[k * n + i]));
+            for (unsigned int e = 0; e < TRANSFORM_SIZE; e++)
+                m[e] = _mm256_fmadd_ps (w, _mm256_i32gather_ps (T + e, offset, 4), m[e]);
+        }
+        const __m256 x = _mm256_loadu_ps (&rest[0][i]), y = _mm256_loadu_ps (&rest[1][i]), z = _mm256_loadu_ps (&rest[2][i]);
+        const __m256 nx = _mm256_loadu_ps (&restNormals[0][i]), ny = _mm256_loadu_ps (&restNormals[1][i]), nz = _mm256_loadu_ps (&restNormals[2][i]);
+        __m256 normal[3];
+        for (unsigned int r = 0; r < 3; r++) {
+            __m256 p = _mm256_fmadd_ps (m[4*r], x, _mm256_fmadd_ps (m[4*r + 1], y, _mm256_fmadd_ps (m[4*r + 2], z, m[4*r + 3])));
+            _mm256_storeu_ps (&out[r][i - begin], p);
+            normal[r] = _mm256_fmadd_ps (m[4*r], nx, _mm256_fmadd_ps (m[4*r + 1], ny, _mm256_mul_ps (m[4*r + 2], nz)));
+        }
+        if (!out[3])
+            continue;
+        __m256 length2 = _mm256_fmadd_ps (normal[0], normal[0], _mm256_fmadd_ps (normal[1], normal[1], _mm256_mul_ps (normal[2], normal[2])));
+        __m256 length = _mm256_sqrt_ps (length2);
+        //normale nulle (vertex sans poids) : on écrit 0 plutôt que NaN
+        __m256 inv = _mm256_and_ps (_mm256_div_ps (_mm256_set1_ps (1.f), length),
+                                    _mm256_cmp_ps (length, _mm256_setzero_ps (), _CMP_GT_OQ));
+        for (unsigned int r = 0; r < 3; r++)
+            _mm256_storeu_ps (&out[3 + r][i - begin], _mm256_mul_ps (normal[r], inv));
+    }
+}
+
+
+__attribute__ ((target ("avx2,fma")))
+void Skinning::deformDQAVX2 (const float * Q, unsigned int begin, unsigned int end, float * const * out) const {
+    const unsigned int n = rest[0].size ();
+    const __m256 sign = _mm256_set1_ps (-0.f);
+    const __m256 two = _mm256_set1_ps (2.f);
+    for (unsigned int i = begin; i < end; i += LANES) {
+        const __m256i offset0 = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (&offsets[i]));
+        __m256 q0[4];
+        for (unsigned int e = 0; e < 4; e++)
+            q0[e] = _mm256_i32gather_ps (Q + e, offset0, 4);
+        __m256 b[8];
+        for (unsigned int e = 0; e < 8; e++)
+            b[e] = _mm256_setzero_ps ();
+        for (unsigned int k = 0; k < nbInfluences; k++) {
+            const __m256i offset = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (&offsets[k * n + i]));
+            __m256 q[8];
+            for (unsigned int e = 0; e < 8; e++)
+                q[e] = _mm256_i32gather_ps (Q + e, offset, 4);
+            __m256 dot = _mm256_fmadd_ps (q[0], q0[0], _mm256_fmadd_ps (q[1], q0[1], _mm256_fmadd_ps (q[2], q0[2], _mm256_mul_ps (q[3], q0[3]))));
+            //le signe du produit scalaire passe sur le poids
+            const __m256 w = _mm256_xor_ps (_mm256_loadu_ps (&weights[k * n + i]), _mm256_and_ps (dot, sign));
+            for (unsigned int e = 0; e < 8; e++)
+                b[e] = _mm256_fmadd_ps (w, q[e], b[e]);
+        }
+        __m256 length = _mm256_sqrt_ps (_mm256_fmadd_ps (b[0], b[0], _mm256_fmadd_ps (b[1], b[1], _mm256_fmadd_ps (b[2], b[2], _mm256_mul_ps (b[3], b[3])))));
+        __m256 inv = _mm256_and_ps (_mm256_div_ps (_mm256_set1_ps (1.f), length),
+                                    _mm256_cmp_ps (length, _mm256_setzero_ps (), _CMP_GT_OQ));
+        for (unsigned int e = 0; e < 8; e++)
+            b[e] = _mm256_mul_ps (b[e], inv);
+        __m256 t[3];
+        t[0] = _mm256_mul_ps (two, _mm256_fmsub_ps (b[3], b[4], _mm256_fmsub_ps (b[7], b[0], _mm256_fmsub_ps (b[1], b[6], _mm256_mul_ps (b[2], b[5])))));
+        t[1] = _mm256_mul_ps (two, _mm256_fmsub_ps (b[3], b[5], _mm256_fmsub_ps (b[7], b[1], _mm256_fmsub_ps (b[2], b[4], _mm256_mul_ps (b[0], b[6])))));
+        t[2] = _mm256_mul_ps (two, _mm256_fmsub_ps (b[3], b[6], _mm256_fmsub_ps (b[7], b[2], _mm256_fmsub_ps (b[0], b[5], _mm256_mul_ps (b[1], b[4])))));
+        for (unsigned int j = 0; j < (out[3] ? 2u : 1u); j++) {
+            const std::vector<float> * source = (j == 0) ? rest : restNormals;
+            __m256 v[3];
+            for (unsigned int r = 0; r < 3; r++)
+                v[r] = _mm256_loadu_ps (&source[r][i]);
+            __m256 c[3];
+            c[0] = _mm256_fmadd_ps (b[3], v[0], _mm256_fmsub_ps (b[1], v[2], _mm256_mul_ps (b[2], v[1])));
+            c[1] = _mm256_fmadd_ps (b[3], v[1], _mm256_fmsub_ps (b[2], v[0], _mm256_mul_ps (b[0], v[2])));
+            c[2] = _mm256_fmadd_ps (b[3], v[2], _mm256_fmsub_ps (b[0], v[1], _mm256_mul_ps (b[1], v[0])));
+            v[0] = _mm256_fmadd_ps (two, _mm256_fmsub_ps (b[1], c[2], _mm256_mul_ps (b[2], c[1])), v[0]);
+            v[1] = _mm256_fmadd_ps (two, _mm256_fmsub_ps (b[2], c[0], _mm256_mul_ps (b[0], c[2])), v[1]);
+            v[2] = _mm256_fmadd_ps (two, _mm256_fmsub_ps (b[0], c[1], _mm256_mul_ps (b[1], c[0])), v[2]);
+            for (unsigned int r = 0; r < 3; r++)
+                _mm256_storeu_ps (&out[3 * j + r][i - begin], (j == 0) ? _mm256_add_ps (v[r], t[r]) : v[r]);
+        }
+    }
+}
+#endif
+
+bool Skinning::hasSIMD () {
+#ifdef SKINNING_AVX2
+    static const bool avx2 = __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void Skinning::deformRange (const float * data, unsigned int begin, unsigned int end, float * const * out) const {
+#ifdef SKINNING_AVX2
+    if (hasSIMD ()) {
+        //begin et end multiples de LANES : les tableaux sont complétés
+        if (mode == DUAL_QUATERNION)
+            deformDQAVX2 (data, begin, end, out);
+        else
+            deformAVX2 (data, begin, end, out);
+        return;
+    }
+#endif
+    if (mode == DUAL_QUATERNION)
+        deformDQScalar (data, begin, std::min (end, nbVertices), out);
+    else
+        deformScalar (data, begin, std::min (end, nbVertices), out);
+}
+
+void Skinning::deformRange (unsigned int begin, unsigned int end) {
+    float * out[6];
+    for (unsigned int c = 0; c < 3; c++) {
+        out[c] = &posed[c][begin];
+        out[3 + c] = &posedNormals[c][begin];
+    }
+    deformRange ((mode == DUAL_QUATERNION) ? quaternions.data () : transforms.data (), begin, end, out);
+}
+
+void Skinning::evaluate (const float * pose, float * positions, float * normals) const {
+    if (!isBound ())
+        return;
+    vector<float> quaternionPose;
+    const float * data = pose;
+    if (mode == DUAL_QUATERNION) {
+        quaternionPose.resize (TRANSFORM_SIZE * nbBones);
+        toQuaternions (pose, nbBones, quaternionPose.data ());
+        data = quaternionPose.data ();
+    }
+    //par tranches qui restent dans le cache, puis entrelacées (x y z) dans les tableaux de sortie
+    float chunk[6][EVALUATE_CHUNK];
+    float * out[6];
+    for (unsigned int c = 0; c < 6; c++)
+        out[c] = (c < 3 || normals) ? chunk[c] : NULL;
+    for (unsigned int begin = 0; begin < nbVertices; begin += EVALUATE_CHUNK) {
+        unsigned int end = std::min (begin + EVALUATE_CHUNK, nbVertices);
+        deformRange (data, begin, padded (end), out);
+        for (unsigned int i = begin; i < end; i++)
+            for (unsigned int c = 0; c < 3; c++) {
+                positions[3 * i + c] = chunk[c][i - begin];
+                if (normals)
+                    normals[3 * i + c] = chunk[3 + c][i - begin];
+            }
+    }
+}
+
+void Skinning::deform () {
+    if (!isBound ())
+        return;
+    if (mode == DUAL_QUATERNION)
+        updateQuaternions ();
+    deformRange (0, rest[0].size ());
+}
+
+void Skinning::apply (vector<Vertex> & vertices, vector<unsigned int> * updated) {
+    if (updated)
+        updated->clear ();
+    if (!isBound () || vertices.size () != nbVertices)
+        return;
+    unsigned int count = 0;
+    for (unsigned int b = 0; b < nbBones; b++)
+        if (dirty[b])
+            count += boneVertexStart[b + 1] - boneVertexStart[b];
+    if (count == 0)
+        return;
+    if (mode == DUAL_QUATERNION)
+        updateQuaternions ();
+
+    blocks.clear ();
+    if (count >= nbVertices / 2) {
+        //la moitié du mesh bouge : un seul passage sur tout le mesh
+        deformRange (0, rest[0].size ());
+        for (unsigned int i = 0; i < blockStamp.size (); i++)
+            blocks.push_back (i);
+    } else {
+        //blocs de LANES vertices contenant au moins un vertex d'un bone modifié
+        if (++stamp == 0) {
+            fill (blockStamp.begin (), blockStamp.end (), 0);
+            stamp = 1;
+        }
+        for (unsigned int b = 0; b < nbBones; b++) {
+            if (!dirty[b])
+                continue;
+            for (unsigned int j = boneVertexStart[b]; j < boneVertexStart[b + 1]; j++) {
+                unsigned int block = boneVertexIndices[j] / LANES;
+                if (blockStamp[block] != stamp) {
+                    blockStamp[block] = stamp;
+                    blocks.push_back (block);
+                }
+            }
+        }
+        for (unsigned int j = 0; j < blocks.size (); j++)
+            deformRange (blocks[j] * LANES, blocks[j] * LANES + LANES);
+    }
+    for (unsigned int j = 0; j < blocks.size (); j++) {
+        unsigned int end = std::min (blocks[j] * LANES + LANES, nbVertices);
+        for (unsigned int i = blocks[j] * LANES; i < end; i++) {
+            vertices[i].setPos (Vec3Df (posed[0][i], posed[1][i], posed[2][i]));
+            vertices[i].setNormal (Vec3Df (posedNormals[0][i], posedNormals[1][i], posedNormals[2][i]));
+            if (updated)
+                updated->push_back (i);
+        }
+    }
+    fill (dirty.begin (), dirty.end (), 0);
+}
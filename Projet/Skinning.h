@@ -0,0 +1,130 @@
+//
+//  Skinning.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__Skinning__
+#define __Projet__Skinning__
+
+#include <vector>
+#include <stdint.h>
+
+#include "Vertex.h"
+
+//noyau AVX2/FMA compilé à part (attribut target) et choisi à l'exécution : pas d'option de compilation à ajouter
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SKINNING_AVX2
+#endif
+
+class Armature;
+class InfluenceTable;
+
+class Skinning {
+    //Linear Blend Skinning : p' = somme sur les K bones du vertex de w_b M_b p, calculé depuis la pose de repos.
+    //bind() garde les positions et normales au repos (et le squelette au repos), les vertices du mesh ne sont
+    //que le résultat : déplacer un bone plusieurs fois ne cumule pas d'erreur.
+    //M_b est une transformation affine 3x4 par bone ; setPose la déduit du squelette courant (rotation minimale
+    //qui amène le bone au repos sur le bone courant, plus translation ; une translation pour un handle).
+    //les données sont en SoA (une composante par tableau, complétées à un multiple de LANES) : le noyau AVX2
+    //traite 8 vertices à la fois, les matrices des bones étant lues par gather. Si le processeur n'a pas AVX2
+    //(cf hasSIMD), même calcul en scalaire.
+    //bind() garde aussi, pour chaque bone, la liste des vertices qu'il influence : apply() ne recalcule que ceux des
+    //bones dont la transformation a changé (par blocs de LANES vertices), le coût suit la zone d'influence.
+    //DUAL_QUATERNION : mêmes poids, mais on mélange les quaternions duaux des bones (Kavan et al. 2007) au lieu
+    //des matrices, ce qui garde le volume aux articulations en torsion (les transformations doivent être rigides).
+public:
+    enum Mode { LINEAR = 0, DUAL_QUATERNION };
+
+    static const unsigned int LANES = 8;
+    //3 lignes de (3 coefficients linéaires + translation)
+    static const unsigned int TRANSFORM_SIZE = 12;
+    //vertices traités à la fois par evaluate (multiple de LANES)
+    static const unsigned int EVALUATE_CHUNK = 256;
+
+    Skinning () : mode (LINEAR), nbVertices (0), nbBones (0), stamp (0) {}
+
+    void bind (const std::vector<Vertex> & vertices, const std::vector<Vertex> & vertices_bones,
+               const std::vector<Armature *> & bones, const InfluenceTable & influences);
+    //autres poids pour la même pose de repos (résultat d'un calcul arrivé pendant une pose) : tout est à
+    //recalculer au prochain apply ; sans effet si la table ne correspond pas aux vertices et bones liés
+    void setInfluences (const InfluenceTable & influences);
+    void clear ();
+    void swap (Skinning & skinning);
+
+    //le mode est gardé par clear et bind
+    inline Mode getMode () const { return mode; }
+    inline void setMode (Mode m) {
+        if (m != mode)
+            dirty.assign (nbBones, 1);
+        mode = m;
+    }
+
+    inline bool isBound () const { return nbBones != 0; }
+    inline unsigned int getNbVertices () const { return nbVertices; }
+    inline unsigned int getNbBones () const { return nbBones; }
+
+    //transformations des bones : squelette au repos -> squelette courant (un bone dont la transformation
+    //change est à recalculer au prochain apply)
+    void setPose (const std::vector<Vertex> & vertices_bones, const std::vector<Armature *> & bones);
+    void setTransform (unsigned int bone, const float m[TRANSFORM_SIZE]);
+    inline const float * getTransform (unsigned int bone) const { return &transforms[TRANSFORM_SIZE * bone]; }
+    void resetTransforms ();
+
+    //recalcule et écrit dans vertices la pose (positions et normales) des vertices influencés par les bones
+    //modifiés depuis le dernier apply ; updated (optionnel) reçoit les indices des vertices écrits
+    void apply (std::vector<Vertex> & vertices, std::vector<unsigned int> * updated = NULL);
+    //calcule tous les tableaux posés (cf getPosed), sans toucher aux vertices
+    void deform ();
+    //vertices influencés par bone (poids non nul)
+    inline const unsigned int * getBoneVertices (unsigned int bone, unsigned int & count) const {
+        count = boneVertexStart[bone + 1] - boneVertexStart[bone];
+        return &boneVertexIndices[boneVertexStart[bone]];
+    }
+    inline const float * getPosed (unsigned int c) const { return posed[c].data (); }
+    inline const float * getPosedNormal (unsigned int c) const { return posedNormals[c].data (); }
+    //pose complète pour d'autres transformations (TRANSFORM_SIZE floats par bone), sans modifier l'objet :
+    //plusieurs threads peuvent s'en servir en même temps (cf AnimationBaker).
+    //positions : 3 floats (x y z) par vertex ; normals (même format) peut être NULL
+    void evaluate (const float * pose, float * positions, float * normals = NULL) const;
+
+    static bool hasSIMD ();
+    //quaternion dual unitaire (partie réelle x y z w, partie duale x y z w, complété à TRANSFORM_SIZE floats)
+    //de chaque transformation rigide
+    static void toQuaternions (const float * transforms, unsigned int nbBones, float * quaternions);
+
+private:
+    void updateQuaternions ();
+    //les noyaux lisent les transformations (ou quaternions duaux) data et écrivent out[c][i - begin] :
+    //positions dans out[0..2], normales dans out[3..5] (ignorées si out[3] est NULL)
+    void deformRange (unsigned int begin, unsigned int end);
+    void deformRange (const float * data, unsigned int begin, unsigned int end, float * const * out) const;
+    void deformScalar (const float * T, unsigned int begin, unsigned int end, float * const * out) const;
+    void deformDQScalar (const float * Q, unsigned int begin, unsigned int end, float * const * out) const;
+#ifdef SKINNING_AVX2
+    void deformAVX2 (const float * T, unsigned int begin, unsigned int end, float * const * out) const;
+    void deformDQAVX2 (const float * Q, unsigned int begin, unsigned int end, float * const * out) const;
+#endif
+
+    Mode mode;
+    unsigned int nbVertices;
+    unsigned int nbBones;
+    unsigned int nbInfluences;
+    std::vector<float> rest[3], restNormals[3];
+    std::vector<float> posed[3], posedNormals[3];
+    std::vector<int32_t> offsets;       // nbInfluences x (taille complétée) : bone * TRANSFORM_SIZE
+    std::vector<float> weights;         // idem, 0 pour une entrée inutilisée
+    std::vector<float> transforms;      // TRANSFORM_SIZE floats par bone
+    std::vector<float> quaternions;     // idem (mêmes offsets) : partie réelle x y z w, partie duale x y z w
+    std::vector<Vec3Df> restBones;      // vertices des bones au repos
+    std::vector<unsigned int> boneVertexStart;      // nbBones + 1 : début de la liste de chaque bone
+    std::vector<unsigned int> boneVertexIndices;    // listes mises bout à bout
+    std::vector<char> dirty;            // transformation modifiée depuis le dernier apply
+    std::vector<unsigned int> blockStamp;           // marque des blocs déjà retenus (cf apply)
+    std::vector<unsigned int> blocks;
+    unsigned int stamp;
+};
+
+#endif /* defined(__Projet__Skinning__) */
@@ -0,0 +1,191 @@
+//
+//  TextScanner.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 20/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__TextScanner__
+#define __Projet__TextScanner__
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+class TextScanner {
+    //lecture de nombres directement dans un buffer (fichier projeté en mémoire).
+    //le buffer n'est pas terminé par '\0' : on teste toujours cur < last.
+public:
+    inline TextScanner (const char * begin, const char * end) : cur (begin), last (end) {}
+
+    inline bool atEnd () const { return cur >= last; }
+    inline const char * position () const { return cur; }
+    inline void setPosition (const char * p) { cur = p; }
+
+    // espaces et tabulations, sans changer de ligne
+    inline void skipBlanks () {
+        while (cur < last && (*cur == ' ' || *cur == '\t' || *cur == '\r'))
+            cur++;
+    }
+
+    // tous les blancs, y compris les fins de ligne
+    inline void skipSpaces () {
+        while (cur < last && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n'))
+            cur++;
+    }
+
+    // blancs + lignes de commentaire commençant par '#'
+    inline void skipSpacesAndComments () {
+        skipSpaces ();
+        while (cur < last && *cur == '#') {
+            skipLine ();
+            skipSpaces ();
+        }
+    }
+
+    // on se place au début de la ligne suivante
+    inline void skipLine () {
+        const char * p = static_cast<const char *> (memchr (cur, '\n', last - cur));
+        cur = (p == NULL) ? last : p + 1;
+    }
+
+    // on saute la fin du mot courant (ex : "/2/3" dans "1/2/3")
+    inline void skipWord () {
+        while (cur < last && !isBlank (*cur))
+            cur++;
+    }
+
+    inline bool atEndOfLine () const { return cur >= last || *cur == '\n'; }
+
+    // lit un mot (suite de caractères non blancs)
+    inline bool readWord (const char * & begin, size_t & size) {
+        skipSpaces ();
+        begin = cur;
+        while (cur < last && !isBlank (*cur))
+            cur++;
+        size = cur - begin;
+        return size != 0;
+    }
+
+    inline bool readUInt (unsigned int & value) {
+        skipSpaces ();
+        if (cur < last && *cur == '+')
+            cur++;
+        if (cur >= last || !isDigit (*cur))
+            return false;
+        unsigned int v = 0;
+        while (cur < last && isDigit (*cur))
+            v = v * 10 + (*cur++ - '0');
+        value = v;
+        return true;
+    }
+
+    inline bool readInt (int & value) {
+        skipSpaces ();
+        bool negative = false;
+        if (cur < last && (*cur == '-' || *cur == '+'))
+            negative = (*cur++ == '-');
+        unsigned int v;
+        if (!readUInt (v))
+            return false;
+        value = negative ? -int (v) : int (v);
+        return true;
+    }
+
+    // [signe] chiffres [. chiffres] [e|E [signe] chiffres]
+    // les cas exotiques (nan, inf, ...) passent par strtod
+    inline bool readFloat (float & value) {
+        skipSpaces ();
+        const char * start = cur;
+        const char * p = cur;
+        bool negative = false;
+        if (p < last && (*p == '-' || *p == '+'))
+            negative = (*p++ == '-');
+
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        int nbDigits = 0;
+        bool any = false;
+        while (p < last && isDigit (*p)) {
+            if (nbDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    nbDigits++;
+            } else
+                exponent++;
+            p++;
+            any = true;
+        }
+        if (p < last && *p == '.') {
+            p++;
+            while (p < last && isDigit (*p)) {
+                if (nbDigits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0)
+                        nbDigits++;
+                    exponent--;
+                }
+                p++;
+                any = true;
+            }
+        }
+        if (!any)
+            return readFloatSlow (start, value);
+        if (p < last && (*p == 'e' || *p == 'E')) {
+            const char * q = p + 1;
+            bool negativeExp = false;
+            if (q < last && (*q == '-' || *q == '+'))
+                negativeExp = (*q++ == '-');
+            if (q < last && isDigit (*q)) {
+                int e = 0;
+                while (q < last && isDigit (*q)) {
+                    if (e < 10000)
+                        e = e * 10 + (*q - '0');
+                    q++;
+                }
+                exponent += negativeExp ? -e : e;
+                p = q;
+            }
+        }
+        double d = double (mantissa);
+        if (exponent != 0 && mantissa != 0)
+            d = (exponent < 0) ? d / pow10 (-exponent) : d * pow10 (exponent);
+        value = float (negative ? -d : d);
+        cur = p;
+        return true;
+    }
+
+private:
+    static inline bool isDigit (char c) { return c >= '0' && c <= '9'; }
+    static inline bool isBlank (char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    static inline double pow10 (int e) {
+        static const double table[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        return (e <= 22) ? table[e] : std::pow (10.0, e);
+    }
+
+    inline bool readFloatSlow (const char * start, float & value) {
+        char buffer[64];
+        size_t n = 0;
+        const char * p = start;
+        while (p < last && !isBlank (*p) && n < sizeof (buffer) - 1)
+            buffer[n++] = *p++;
+        buffer[n] = '\0';
+        char * stop;
+        double d = strtod (buffer, &stop);
+        if (stop == buffer)
+            return false;
+        value = float (d);
+        cur = start + (stop - buffer);
+        return true;
+    }
+
+    const char * cur;
+    const char * last;
+};
+
+#endif /* defined(__Projet__TextScanner__) */
@@ -0,0 +1,20 @@
+//
+//  Threads.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__Threads__
+#define __Projet__Threads__
+
+#include <thread>
+
+//nombre de threads par défaut des calculs parallèles : un par coeur, au moins un si le système ne sait pas le dire
+inline unsigned int defaultNbThreads () {
+    unsigned int n = std::thread::hardware_concurrency ();
+    return n == 0 ? 1 : n;
+}
+
+#endif /* defined(__Projet__Threads__) */
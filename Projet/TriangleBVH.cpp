@@ -0,0 +1,140 @@
+//
+//  TriangleBVH.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "TriangleBVH.h"
+#include "Threads.h"
+
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+const unsigned int TriangleBVH::LEAF_SIZE;
+const size_t TriangleBVH::MIN_SEGMENTS_PER_THREAD;
+const float TriangleBVH::START_EPSILON = 1e-3f;
+
+TriangleBVH::TriangleBVH () : nbThreads (defaultNbThreads ()) {}
+
+void TriangleBVH::build (const vector<Vertex> & vertices, const vector<Triangle> & triangles) {
+    nodes.clear ();
+    order.clear ();
+    geometry.clear ();
+    if (triangles.empty ())
+        return;
+
+    vector<float> bounds (6 * triangles.size ()), centers (3 * triangles.size ());
+    for (unsigned int t = 0; t < triangles.size (); t++) {
+        for (unsigned int c = 0; c < 3; c++) {
+            bounds[6*t + c] = numeric_limits<float>::max ();
+            bounds[6*t + 3 + c] = -numeric_limits<float>::max ();
+            centers[3*t + c] = 0.f;
+        }
+        for (unsigned int j = 0; j < 3; j++) {
+            const Vec3Df & p = vertices[triangles[t].getVertex (j)].getPos ();
+            for (unsigned int c = 0; c < 3; c++) {
+                bounds[6*t + c] = min (bounds[6*t + c], p[c]);
+                bounds[6*t + 3 + c] = max (bounds[6*t + 3 + c], p[c]);
+                centers[3*t + c] += p[c];
+            }
+        }
+        for (unsigned int c = 0; c < 3; c++)
+            centers[3*t + c] /= 3.f;
+    }
+    MedianSplitBVH::build (bounds, centers, LEAF_SIZE, nodes, order);
+
+    geometry.resize (9 * order.size ());
+    for (unsigned int i = 0; i < order.size (); i++) {
+        const Triangle & triangle = triangles[order[i]];
+        const Vec3Df & v0 = vertices[triangle.getVertex (0)].getPos ();
+        Vec3Df e1 = vertices[triangle.getVertex (1)].getPos () - v0;
+        Vec3Df e2 = vertices[triangle.getVertex (2)].getPos () - v0;
+        for (unsigned int c = 0; c < 3; c++) {
+            geometry[9*i + c] = v0[c];
+            geometry[9*i + 3 + c] = e1[c];
+            geometry[9*i + 6 + c] = e2[c];
+        }
+    }
+}
+
+bool TriangleBVH::occluded (const Vec3Df & a, const Vec3Df & b) const {
+    if (nodes.empty ())
+        return false;
+    const float o[3] = {a[0], a[1], a[2]};
+    const float d[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float inverse[3];
+    for (unsigned int c = 0; c < 3; c++)
+        inverse[c] = 1.f / d[c];
+
+    unsigned int stack[64];
+    unsigned int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node & node = nodes[stack[--top]];
+
+        //test des plans (slabs) sur [START_EPSILON, 1]
+        float tNear = START_EPSILON, tFar = 1.f;
+        for (unsigned int c = 0; c < 3; c++) {
+            float t0 = (node.min[c] - o[c]) * inverse[c];
+            float t1 = (node.max[c] - o[c]) * inverse[c];
+            tNear = max (tNear, min (t0, t1));
+            tFar = min (tFar, max (t0, t1));
+        }
+        if (tNear > tFar)
+            continue;
+
+        if (node.count == 0) {
+            stack[top++] = node.left;
+            stack[top++] = node.right;
+            continue;
+        }
+
+        //Möller-Trumbore : a + t d = v0 + u e1 + v e2
+        for (unsigned int i = node.first; i < node.first + node.count; i++) {
+            const float * g = &geometry[9 * i];
+            const float * e1 = g + 3;
+            const float * e2 = g + 6;
+            float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+            float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+            //segment parallèle au triangle (ou triangle dégénéré)
+            if (det == 0.f)
+                continue;
+            float inv = 1.f / det;
+            float s[3] = {o[0] - g[0], o[1] - g[1], o[2] - g[2]};
+            float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+            if (u < 0.f || u > 1.f)
+                continue;
+            float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+            float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+            if (v < 0.f || u + v > 1.f)
+                continue;
+            float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+            if (t > START_EPSILON && t <= 1.f)
+                return true;
+        }
+    }
+    return false;
+}
+
+void TriangleBVH::occludedRange (const vector<Segment> & segments, size_t begin, size_t end, vector<char> & result) const {
+    for (size_t i = begin; i < end; i++)
+        result[i] = occluded (segments[i].a, segments[i].b) ? 1 : 0;
+}
+
+void TriangleBVH::occluded (const vector<Segment> & segments, vector<char> & result) const {
+    result.assign (segments.size (), 0);
+    size_t nbChunks = max<size_t> (1, min<size_t> (nbThreads, segments.size () / MIN_SEGMENTS_PER_THREAD));
+    vector<thread> workers;
+    for (size_t c = 1; c < nbChunks; c++)
+        workers.push_back (thread (&TriangleBVH::occludedRange, this, cref (segments),
+                                   segments.size () * c / nbChunks, segments.size () * (c+1) / nbChunks, ref (result)));
+    occludedRange (segments, 0, segments.size () / nbChunks, result);
+    for (size_t i = 0; i < workers.size (); i++)
+        workers[i].join ();
+}
@@ -0,0 +1,61 @@
+//
+//  TriangleBVH.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__TriangleBVH__
+#define __Projet__TriangleBVH__
+
+#include <vector>
+
+#include "Vertex.h"
+#include "Triangle.h"
+#include "MedianSplitBVH.h"
+
+class TriangleBVH {
+    //BVH des triangles du mesh pour savoir si un segment traverse la surface (cf NearestBone::queryVisible :
+    //le segment d'un vertex à son bone doit rester à l'intérieur du mesh).
+    //découpage à la médiane des centres (cf MedianSplitBVH) ; les triangles sont recopiés dans l'ordre des
+    //feuilles (sommet + deux arêtes) pour le test de Möller-Trumbore.
+    //les requêtes par lot sont réparties sur plusieurs threads (tranches contiguës de segments).
+public:
+    static const unsigned int LEAF_SIZE = 4;
+    //en dessous de ce nombre de segments par thread, on ne découpe pas
+    static const size_t MIN_SEGMENTS_PER_THREAD = 4 * 1024;
+    //début du segment ignoré (en fraction de sa longueur) : le vertex de départ est sur ses propres triangles
+    static const float START_EPSILON;
+
+    struct Segment {
+        Vec3Df a, b;
+    };
+
+    TriangleBVH ();
+
+    inline void setNbThreads (unsigned int n) { nbThreads = n; }
+    inline unsigned int getNbThreads () const { return nbThreads; }
+
+    void build (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles);
+    inline bool empty () const { return nodes.empty (); }
+    inline unsigned int getNbTriangles () const { return order.size (); }
+
+    //le segment [a, b] coupe un triangle ailleurs que dans sa partie initiale (cf START_EPSILON)
+    bool occluded (const Vec3Df & a, const Vec3Df & b) const;
+    //occluded[i] pour chaque segment, en parallèle
+    void occluded (const std::vector<Segment> & segments, std::vector<char> & occluded) const;
+
+private:
+    //feuille : triangles aux positions first .. first+count-1 de geometry
+    typedef MedianSplitBVH::Node Node;
+
+    void occludedRange (const std::vector<Segment> & segments, size_t begin, size_t end, std::vector<char> & occluded) const;
+
+    unsigned int nbThreads;
+    std::vector<Node> nodes;
+    std::vector<unsigned int> order;    // index du triangle d'origine, dans l'ordre des feuilles
+    std::vector<float> geometry;        // 9 floats par triangle (dans l'ordre des feuilles) : v0, v1 - v0, v2 - v0
+};
+
+#endif /* defined(__Projet__TriangleBVH__) */
@@ -0,0 +1,110 @@
+//
+//  VertexNormals.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "VertexNormals.h"
+
+#include <algorithm>
+
+using namespace std;
+
+static inline Vec3Df triangleNormal (const vector<Vertex> & vertices, const Triangle & t) {
+    Vec3Df e01 (vertices[t.getVertex (1)].getPos () - vertices[t.getVertex (0)].getPos ());
+    Vec3Df e02 (vertices[t.getVertex (2)].getPos () - vertices[t.getVertex (0)].getPos ());
+    Vec3Df n (Vec3Df::crossProduct (e01, e02));
+    n.normalize ();
+    return n;
+}
+
+void VertexNormals::clear () {
+    triangleStart.clear ();
+    vertexTriangles.clear ();
+    triangleNormals.clear ();
+    triangleStamp.clear ();
+    vertexStamp.clear ();
+    triangleList.clear ();
+    vertexList.clear ();
+    stamp = 0;
+}
+
+void VertexNormals::swap (VertexNormals & normals) {
+    triangleStart.swap (normals.triangleStart);
+    vertexTriangles.swap (normals.vertexTriangles);
+    triangleNormals.swap (normals.triangleNormals);
+    triangleStamp.swap (normals.triangleStamp);
+    vertexStamp.swap (normals.vertexStamp);
+    triangleList.swap (normals.triangleList);
+    vertexList.swap (normals.vertexList);
+    std::swap (stamp, normals.stamp);
+}
+
+void VertexNormals::build (const vector<Vertex> & vertices, const vector<Triangle> & triangles) {
+    clear ();
+    //adjacence par comptage
+    triangleStart.assign (vertices.size () + 1, 0);
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        for (unsigned int j = 0; j < 3; j++)
+            triangleStart[triangles[t].getVertex (j) + 1]++;
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        triangleStart[i + 1] += triangleStart[i];
+    vertexTriangles.resize (triangleStart.back ());
+    vector<unsigned int> next (triangleStart.begin (), triangleStart.end () - 1);
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        for (unsigned int j = 0; j < 3; j++)
+            vertexTriangles[next[triangles[t].getVertex (j)]++] = t;
+
+    triangleNormals.resize (triangles.size ());
+    for (unsigned int t = 0; t < triangles.size (); t++)
+        triangleNormals[t] = triangleNormal (vertices, triangles[t]);
+    triangleStamp.assign (triangles.size (), 0);
+    vertexStamp.assign (vertices.size (), 0);
+}
+
+void VertexNormals::update (vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                            const vector<unsigned int> & moved) {
+    if (!isBuilt (vertices.size (), triangles.size ()))
+        build (vertices, triangles);
+    if (++stamp == 0) {
+        fill (triangleStamp.begin (), triangleStamp.end (), 0);
+        fill (vertexStamp.begin (), vertexStamp.end (), 0);
+        stamp = 1;
+    }
+    //triangles incidents aux vertices déplacés
+    triangleList.clear ();
+    for (unsigned int j = 0; j < moved.size (); j++) {
+        unsigned int v = moved[j];
+        for (unsigned int k = triangleStart[v]; k < triangleStart[v + 1]; k++) {
+            unsigned int t = vertexTriangles[k];
+            if (triangleStamp[t] != stamp) {
+                triangleStamp[t] = stamp;
+                triangleList.push_back (t);
+            }
+        }
+    }
+    //leurs normales, puis les sommets de ces triangles
+    vertexList.clear ();
+    for (unsigned int j = 0; j < triangleList.size (); j++) {
+        const Triangle & t = triangles[triangleList[j]];
+        triangleNormals[triangleList[j]] = triangleNormal (vertices, t);
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int v = t.getVertex (k);
+            if (vertexStamp[v] != stamp) {
+                vertexStamp[v] = stamp;
+                vertexList.push_back (v);
+            }
+        }
+    }
+    for (unsigned int j = 0; j < vertexList.size (); j++) {
+        unsigned int v = vertexList[j];
+        Vec3Df n (0.0, 0.0, 0.0);
+        for (unsigned int k = triangleStart[v]; k < triangleStart[v + 1]; k++)
+            n += triangleNormals[vertexTriangles[k]];
+        if (n != Vec3Df (0.0, 0.0, 0.0))
+            n.normalize ();
+        vertices[v].setNormal (n);
+    }
+}
@@ -0,0 +1,49 @@
+//
+//  VertexNormals.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__VertexNormals__
+#define __Projet__VertexNormals__
+
+#include <vector>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class VertexNormals {
+    //normales lissées des vertices (somme des normales des triangles incidents, comme
+    //Mesh::recomputeSmoothVertexNormals (0)) remises à jour seulement autour des vertices déplacés.
+    //build() prépare l'adjacence vertex -> triangles (en CSR) et garde la normale de chaque triangle ;
+    //update() recalcule les triangles incidents aux vertices déplacés puis les normales des sommets de
+    //ces triangles (le 1-voisinage) : le coût suit la taille de la modification.
+    //les normales gardées ne sont justes que si tout déplacement de vertex passe par update (sinon build).
+public:
+    VertexNormals () : stamp (0) {}
+
+    void build (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles);
+    void clear ();
+    void swap (VertexNormals & normals);
+
+    //construit pour ce nombre de vertices et de triangles
+    inline bool isBuilt (unsigned int nbVertices, unsigned int nbTriangles) const {
+        return !triangleStart.empty () && triangleStart.size () == nbVertices + 1 && triangleNormals.size () == nbTriangles;
+    }
+
+    void update (std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                 const std::vector<unsigned int> & moved);
+
+private:
+    std::vector<unsigned int> triangleStart;    // nbVertices + 1 : début des triangles de chaque vertex
+    std::vector<unsigned int> vertexTriangles;  // listes mises bout à bout
+    std::vector<Vec3Df> triangleNormals;
+    //marques des triangles et vertices déjà retenus par update (pas de remise à zéro entre deux appels)
+    std::vector<unsigned int> triangleStamp, vertexStamp;
+    std::vector<unsigned int> triangleList, vertexList;
+    unsigned int stamp;
+};
+
+#endif /* defined(__Projet__VertexNormals__) */
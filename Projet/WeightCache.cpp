@@ -0,0 +1,235 @@
+//
+//  WeightCache.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "WeightCache.h"
+#include "WeightSolver.h"
+#include "InfluenceTable.h"
+#include "MappedFile.h"
+#include "Armature.h"
+
+#include <algorithm>
+#include <mutex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace std;
+
+const uint32_t WeightCache::VERSION;
+const uint64_t WeightCache::DEFAULT_MAX_SIZE;
+const unsigned int WeightCache::DEFAULT_MAX_ENTRIES;
+
+static const uint32_t ENDIANNESS = 0x01020304;
+static const char * EXTENSION = ".weights";
+
+//plusieurs threads (MeshLoader, MeshBatch) peuvent écrire en même temps : un seul fait le ménage à la fois
+static mutex evictionMutex;
+
+static inline uint64_t align16 (uint64_t offset) {
+    return (offset + 15) & ~uint64_t (15);
+}
+
+//position des poids dans une entrée : après les K bones de chaque vertex
+static inline uint64_t weightsOffset (uint32_t nbVertices) {
+    return align16 (sizeof (WeightCache::Header) + uint64_t (nbVertices) * InfluenceTable::K * sizeof (uint16_t));
+}
+
+static inline uint64_t entrySize (uint32_t nbVertices) {
+    return weightsOffset (nbVertices) + uint64_t (nbVertices) * InfluenceTable::K * sizeof (float);
+}
+
+//équivalent de mkdir -p
+static bool makeDirectories (const string & path) {
+    struct stat st;
+    if (path.empty () || stat (path.c_str (), &st) == 0)
+        return !path.empty () && S_ISDIR (st.st_mode);
+    size_t slash = path.find_last_of ('/');
+    if (slash != string::npos && slash != 0 && !makeDirectories (path.substr (0, slash)))
+        return false;
+    return mkdir (path.c_str (), 0755) == 0 || (stat (path.c_str (), &st) == 0 && S_ISDIR (st.st_mode));
+}
+
+WeightCache::WeightCache ()
+    : directory (defaultDirectory ()), enabled (true), maxSize (DEFAULT_MAX_SIZE), maxEntries (DEFAULT_MAX_ENTRIES) {}
+
+WeightCache::WeightCache (const string & d)
+    : directory (d), enabled (true), maxSize (DEFAULT_MAX_SIZE), maxEntries (DEFAULT_MAX_ENTRIES) {}
+
+WeightCache & WeightCache::shared () {
+    static WeightCache cache;
+    return cache;
+}
+
+string WeightCache::defaultDirectory () {
+    const char * env = getenv ("PROJET_WEIGHT_CACHE");
+    if (env != NULL)
+        return env;
+    const char * home = getenv ("HOME");
+    if (home != NULL && home[0] != '\0')
+        return string (home) + "/.cache/Projet/weights";
+    return "";
+}
+
+uint64_t WeightCache::key (const vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                           const vector<Vertex> & vertices_bones, const vector<Armature *> & bones) {
+    uint64_t hash = WeightSolver::geometryKey (vertices, triangles);
+    const uint64_t prime = 1099511628211ULL;
+    for (unsigned int i = 0; i < vertices_bones.size (); i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            float f = vertices_bones[i].getPos ()[c];
+            uint32_t bits;
+            memcpy (&bits, &f, sizeof (bits));
+            hash = (hash ^ bits) * prime;
+        }
+    //un handle n'a qu'un vertex : on le distingue d'un bone dont les deux vertices seraient confondus
+    for (unsigned int i = 0; i < bones.size (); i++) {
+        bool handle = bones[i]->getType () == "handle";
+        hash = (hash ^ (handle ? 1u : 0u)) * prime;
+        hash = (hash ^ bones[i]->getVertex (0)) * prime;
+        hash = (hash ^ (handle ? bones[i]->getVertex (0) : bones[i]->getVertex (1))) * prime;
+    }
+    //format des entrées : une table avec un autre K n'a pas la même clé
+    hash = (hash ^ (uint64_t (InfluenceTable::K) << 32 | VERSION)) * prime;
+    return hash ^ (uint64_t (vertices_bones.size ()) << 32) ^ bones.size ();
+}
+
+string WeightCache::entryName (uint64_t key) const {
+    char name[17];
+    snprintf (name, sizeof (name), "%016llx", (unsigned long long) key);
+    return directory + "/" + name + EXTENSION;
+}
+
+bool WeightCache::load (uint64_t key, unsigned int nbVertices, unsigned int nbBones, InfluenceTable & influences) const {
+    if (!isEnabled ())
+        return false;
+    string filename = entryName (key);
+    MappedFile file (filename);
+    if (!file.isOpen ())
+        return false;
+
+    bool valid = file.size () >= sizeof (Header);
+    Header header;
+    if (valid) {
+        memcpy (&header, file.data (), sizeof (Header));
+        valid = memcmp (header.magic, "WEIGHTS", 8) == 0 && header.version == VERSION && header.endianness == ENDIANNESS
+            && header.nbInfluences == InfluenceTable::K && file.size () >= entrySize (header.nbVertices);
+    }
+    const uint16_t * bones = reinterpret_cast<const uint16_t *> (file.data () + sizeof (Header));
+    for (uint64_t i = 0; valid && i < uint64_t (header.nbVertices) * InfluenceTable::K; i++)
+        valid = bones[i] < header.nbBones || bones[i] == InfluenceTable::NO_BONE;
+    if (!valid) {
+        //entrée tronquée ou d'une autre version : elle ne servira plus
+        file.close ();
+        remove (filename.c_str ());
+        return false;
+    }
+    //collision de clé (ou autre mesh) : on ne touche pas à l'entrée
+    if (header.key != key || header.nbVertices != nbVertices || header.nbBones != nbBones)
+        return false;
+
+    const float * weights = reinterpret_cast<const float *> (file.data () + weightsOffset (header.nbVertices));
+    influences.assign (header.nbVertices, header.nbBones, bones, weights);
+    file.close ();
+
+    //LRU : la date de modification sert de date de dernière utilisation
+    utimes (filename.c_str (), NULL);
+    return true;
+}
+
+bool WeightCache::store (uint64_t key, const InfluenceTable & influences) const {
+    if (!isEnabled () || influences.empty () || !makeDirectories (directory))
+        return false;
+
+    Header header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, "WEIGHTS", 8);
+    header.version = VERSION;
+    header.endianness = ENDIANNESS;
+    header.key = key;
+    header.nbVertices = influences.getNbVertices ();
+    header.nbBones = influences.getNbBones ();
+    header.nbInfluences = InfluenceTable::K;
+
+    vector<char> buffer (entrySize (header.nbVertices), 0);
+    memcpy (buffer.data (), &header, sizeof (header));
+    uint16_t * bones = reinterpret_cast<uint16_t *> (buffer.data () + sizeof (Header));
+    float * weights = reinterpret_cast<float *> (buffer.data () + weightsOffset (header.nbVertices));
+    for (unsigned int i = 0; i < header.nbVertices; i++)
+        for (unsigned int k = 0; k < InfluenceTable::K; k++) {
+            bones[InfluenceTable::K*i + k] = influences.getBone (i, k);
+            weights[InfluenceTable::K*i + k] = influences.getWeight (i, k);
+        }
+
+    //fichier temporaire propre à l'écrivain puis rename : une entrée n'est jamais lue à moitié écrite
+    string filename = entryName (key);
+    char suffix[32];
+    snprintf (suffix, sizeof (suffix), ".%d.%p.tmp", int (getpid ()), (void *) &buffer);
+    string tmpName = filename + suffix;
+    FILE * file = fopen (tmpName.c_str (), "wb");
+    if (file == NULL)
+        return false;
+    size_t written = fwrite (buffer.data (), 1, buffer.size (), file);
+    bool ok = fclose (file) == 0 && written == buffer.size () && rename (tmpName.c_str (), filename.c_str ()) == 0;
+    if (!ok)
+        remove (tmpName.c_str ());
+    else
+        evict (filename);
+    return ok;
+}
+
+void WeightCache::listEntries (vector<Entry> & entries) const {
+    entries.clear ();
+    DIR * d = opendir (directory.c_str ());
+    if (d == NULL)
+        return;
+    const size_t extensionLength = strlen (EXTENSION);
+    while (struct dirent * e = readdir (d)) {
+        string name = e->d_name;
+        if (name.size () <= extensionLength || name.compare (name.size () - extensionLength, extensionLength, EXTENSION) != 0)
+            continue;
+        Entry entry;
+        entry.filename = directory + "/" + name;
+        struct stat st;
+        if (stat (entry.filename.c_str (), &st) != 0)
+            continue;
+        entry.size = st.st_size;
+        entry.lastUse = st.st_mtime;
+        entries.push_back (entry);
+    }
+    closedir (d);
+}
+
+void WeightCache::evict (const string & keep) const {
+    lock_guard<mutex> lock (evictionMutex);
+    vector<Entry> entries;
+    listEntries (entries);
+    uint64_t total = 0;
+    for (size_t i = 0; i < entries.size (); i++)
+        total += entries[i].size;
+    //keep (l'entrée qu'on vient d'écrire) est gardée même si elle dépasse maxSize à elle seule
+    sort (entries.begin (), entries.end ());
+    size_t count = entries.size ();
+    for (size_t i = 0; i < entries.size () && (total > maxSize || count > maxEntries); i++) {
+        if (entries[i].filename == keep || remove (entries[i].filename.c_str ()) != 0)
+            continue;
+        total -= entries[i].size;
+        count--;
+    }
+}
+
+void WeightCache::clear () const {
+    lock_guard<mutex> lock (evictionMutex);
+    vector<Entry> entries;
+    listEntries (entries);
+    for (size_t i = 0; i < entries.size (); i++)
+        remove (entries[i].filename.c_str ());
+}
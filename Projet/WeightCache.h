@@ -0,0 +1,94 @@
+//
+//  WeightCache.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__WeightCache__
+#define __Projet__WeightCache__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class Armature;
+class InfluenceTable;
+
+class WeightCache {
+    //cache disque des poids du skinning : une entrée par (mesh, squelette), nommée par une clé calculée
+    //sur les vertices, les triangles, les vertices des bones et les bones. Rouvrir un modèle, cocher
+    //"Bone's influencial area" ou réinitialiser relit la table des influences au lieu de refaire la résolution.
+    //une entrée est un fichier <clé>.weights : en-tête, K bones (uint16) puis K poids (float) par vertex,
+    //lu par projection en mémoire (cf MappedFile).
+    //taille limitée : après chaque écriture on supprime les entrées les moins récemment utilisées
+    //(la date de modification d'une entrée est remise à jour à chaque lecture).
+public:
+    //fait partie de la clé : à changer quand le calcul des poids change (les anciennes entrées ne servent plus)
+    static const uint32_t VERSION = 2;
+    static const uint64_t DEFAULT_MAX_SIZE = 256ULL * 1024 * 1024;
+    static const unsigned int DEFAULT_MAX_ENTRIES = 128;
+
+    struct Header {
+        char magic[8];          // "WEIGHTS"
+        uint32_t version;
+        uint32_t endianness;    // 0x01020304 écrit dans l'ordre de la machine
+        uint64_t key;
+        uint32_t nbVertices;
+        uint32_t nbBones;
+        uint32_t nbInfluences;  // InfluenceTable::K
+        uint8_t padding[28];
+    };
+
+    //dossier : $PROJET_WEIGHT_CACHE, sinon ~/.cache/Projet/weights
+    WeightCache ();
+    WeightCache (const std::string & directory);
+    virtual ~WeightCache () {}
+
+    //cache utilisé par Mesh::initWeights
+    static WeightCache & shared ();
+    static std::string defaultDirectory ();
+
+    inline void setDirectory (const std::string & d) { directory = d; }
+    inline const std::string & getDirectory () const { return directory; }
+    inline void setEnabled (bool b) { enabled = b; }
+    inline bool isEnabled () const { return enabled && !directory.empty (); }
+    inline void setMaxSize (uint64_t bytes) { maxSize = bytes; }
+    inline uint64_t getMaxSize () const { return maxSize; }
+    inline void setMaxEntries (unsigned int n) { maxEntries = n; }
+    inline unsigned int getMaxEntries () const { return maxEntries; }
+
+    //FNV-1a sur la géométrie (cf WeightSolver::geometryKey) puis sur le squelette
+    static uint64_t key (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                         const std::vector<Vertex> & vertices_bones, const std::vector<Armature *> & bones);
+
+    //false si l'entrée n'existe pas ou ne correspond pas (une entrée illisible est supprimée)
+    bool load (uint64_t key, unsigned int nbVertices, unsigned int nbBones, InfluenceTable & influences) const;
+    //écrit l'entrée (fichier temporaire puis rename) puis fait de la place ; false si l'écriture échoue
+    bool store (uint64_t key, const InfluenceTable & influences) const;
+    //supprime les entrées les plus anciennes (sauf keep) jusqu'à respecter maxSize et maxEntries
+    void evict (const std::string & keep = "") const;
+    void clear () const;
+
+    std::string entryName (uint64_t key) const;
+
+private:
+    struct Entry {
+        std::string filename;
+        uint64_t size;
+        int64_t lastUse; // date de modification, en secondes
+        inline bool operator< (const Entry & e) const { return lastUse < e.lastUse; }
+    };
+    void listEntries (std::vector<Entry> & entries) const;
+
+    std::string directory;
+    bool enabled;
+    uint64_t maxSize;
+    unsigned int maxEntries;
+};
+
+#endif /* defined(__Projet__WeightCache__) */
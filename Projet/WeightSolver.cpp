@@ -0,0 +1,224 @@
+//
+//  WeightSolver.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 28/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "WeightSolver.h"
+#include "Laplacian.h"
+#include "Multigrid.h"
+#include "Progress.h"
+
+#include <cstring>
+
+using namespace std;
+
+const unsigned int WeightSolver::MULTIGRID_THRESHOLD;
+const float WeightSolver::DEFAULT_TOLERANCE = 1e-5f;
+
+WeightSolver::WeightSolver ()
+    : mode (AUTO), preconditioner (JACOBI), tolerance (DEFAULT_TOLERANCE), maxIterations (0),
+      prepared (false), key (0), nbVertices (0), lastIterations (0) {}
+
+WeightSolver::WeightSolver (const WeightSolver & solver)
+    : mode (solver.mode), preconditioner (solver.preconditioner), tolerance (solver.tolerance), maxIterations (solver.maxIterations),
+      prepared (false), key (0), nbVertices (0), lastIterations (0) {}
+
+WeightSolver::~WeightSolver () {}
+
+WeightSolver & WeightSolver::operator= (const WeightSolver & solver) {
+    if (this != &solver) {
+        clear ();
+        mode = solver.mode;
+        preconditioner = solver.preconditioner;
+        tolerance = solver.tolerance;
+        maxIterations = solver.maxIterations;
+    }
+    return *this;
+}
+
+void WeightSolver::swap (WeightSolver & solver) {
+    std::swap (mode, solver.mode);
+    std::swap (preconditioner, solver.preconditioner);
+    std::swap (tolerance, solver.tolerance);
+    std::swap (maxIterations, solver.maxIterations);
+    std::swap (prepared, solver.prepared);
+    std::swap (key, solver.key);
+    std::swap (nbVertices, solver.nbVertices);
+    L.swap (solver.L);
+    A.swap (solver.A);
+    minusLDiagonal.swap (solver.minusLDiagonal);
+    diagonalIndex.swap (solver.diagonalIndex);
+    solver.solver.swap (this->solver);
+    solver.multigrid.swap (multigrid);
+    previous.swap (solver.previous);
+    std::swap (lastIterations, solver.lastIterations);
+}
+
+void WeightSolver::clear () {
+    prepared = false;
+    key = 0;
+    nbVertices = 0;
+    L = Eigen::SparseMatrix<float> ();
+    A = Eigen::SparseMatrix<float> ();
+    minusLDiagonal = Eigen::VectorXf ();
+    diagonalIndex.clear ();
+    solver.reset ();
+    multigrid.reset ();
+    previous = Eigen::MatrixXf ();
+    lastIterations = 0;
+}
+
+WeightSolver::Mode WeightSolver::effectiveMode (unsigned int n) const {
+    if (mode != AUTO)
+        return mode;
+    return (n >= MULTIGRID_THRESHOLD) ? MULTIGRID : DIRECT;
+}
+
+//FNV-1a sur les positions et les index : change dès qu'un vertex bouge ou que la topologie change
+uint64_t WeightSolver::geometryKey (const vector<Vertex> & vertices, const vector<Triangle> & triangles) {
+    uint64_t hash = 14695981039346656037ULL;
+    const uint64_t prime = 1099511628211ULL;
+    for (unsigned int i = 0; i < vertices.size (); i++)
+        for (unsigned int c = 0; c < 3; c++) {
+            float f = vertices[i].getPos ()[c];
+            uint32_t bits;
+            memcpy (&bits, &f, sizeof (bits));
+            hash = (hash ^ bits) * prime;
+        }
+    for (unsigned int i = 0; i < triangles.size (); i++)
+        for (unsigned int j = 0; j < 3; j++)
+            hash = (hash ^ triangles[i].getVertex (j)) * prime;
+    return hash ^ (uint64_t (vertices.size ()) << 32) ^ triangles.size ();
+}
+
+bool WeightSolver::isPrepared (const vector<Vertex> & vertices, const vector<Triangle> & triangles) const {
+    return prepared && nbVertices == vertices.size () && key == geometryKey (vertices, triangles);
+}
+
+void WeightSolver::prepare (const vector<Vertex> & vertices, const vector<Triangle> & triangles) {
+    clear ();
+    nbVertices = vertices.size ();
+    key = geometryKey (vertices, triangles);
+    Laplacian ().build (vertices, triangles, L);
+
+    //A = -L + Id : la diagonale est toujours dans le motif, même pour un vertex isolé
+    Eigen::SparseMatrix<float> identity (nbVertices, nbVertices);
+    identity.setIdentity ();
+    A = -L + identity;
+    A.makeCompressed ();
+    minusLDiagonal = -L.diagonal ();
+
+    diagonalIndex.assign (nbVertices, -1);
+    for (int k = 0; k < A.outerSize (); k++)
+        for (int p = A.outerIndexPtr ()[k]; p < A.outerIndexPtr ()[k+1]; p++)
+            if (A.innerIndexPtr ()[p] == k)
+                diagonalIndex[k] = p;
+
+    prepared = true;
+}
+
+bool WeightSolver::solve (const vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                          const Eigen::VectorXf & h, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress) {
+    if (!isPrepared (vertices, triangles))
+        prepare (vertices, triangles);
+    if (progress)
+        progress->set ("Calcul des poids", 0.f);
+
+    //seule la diagonale de A dépend du squelette : on la réécrit puis on refactorise
+    float * values = A.valuePtr ();
+    for (unsigned int i = 0; i < nbVertices; i++)
+        values[diagonalIndex[i]] = minusLDiagonal[i] + h[i];
+
+    switch (effectiveMode (nbVertices)) {
+        case ITERATIVE: return solveIterative (rhs, x, progress);
+        case MULTIGRID: return solveMultigrid (vertices, triangles, rhs, x, progress);
+        default: return solveDirect (rhs, x, progress);
+    }
+}
+
+bool WeightSolver::solveDirect (const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress) {
+    lastIterations = 0;
+    previous = Eigen::MatrixXf ();
+    multigrid.reset ();
+    if (!solver) {
+        solver.reset (new Solver ());
+        solver->analyzePattern (A);
+    }
+    solver->factorize (A);
+    if (solver->info () != Eigen::Success)
+        return false;
+    if (progress)
+        progress->set ("Calcul des poids", 0.5f);
+    x = solver->solve (rhs);
+    return solver->info () == Eigen::Success;
+}
+
+template <class CG>
+bool WeightSolver::runConjugateGradient (CG & cg, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress) {
+    cg.setTolerance (tolerance);
+    if (maxIterations != 0)
+        cg.setMaxIterations (maxIterations);
+    cg.compute (A);
+    if (cg.info () != Eigen::Success)
+        return false;
+
+    x.resize (rhs.rows (), rhs.cols ());
+    lastIterations = 0;
+    bool converged = true;
+    for (int j = 0; j < rhs.cols (); j++) {
+        if (progress)
+            progress->set ("Calcul des poids", float (j) / rhs.cols ());
+        Eigen::VectorXf guess;
+        warmStart (rhs, j, guess);
+        x.col (j) = cg.solveWithGuess (rhs.col (j), guess);
+        lastIterations = std::max<unsigned int> (lastIterations, cg.iterations ());
+        converged = converged && cg.info () == Eigen::Success;
+    }
+    previous = x;
+    return converged;
+}
+
+//point de départ : les poids précédents quand ils existent (après une modification du squelette
+//ils sont proches de la nouvelle solution). Un bone ajouté à la fin part de 0.
+void WeightSolver::warmStart (const Eigen::MatrixXf & rhs, unsigned int column, Eigen::VectorXf & guess) const {
+    if (previous.rows () == rhs.rows () && column < previous.cols () && previous.cols () <= rhs.cols ())
+        guess = previous.col (column);
+    else
+        guess = Eigen::VectorXf::Zero (rhs.rows ());
+}
+
+bool WeightSolver::solveMultigrid (const vector<Vertex> & vertices, const vector<Triangle> & triangles,
+                                   const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress) {
+    solver.reset ();
+    if (!multigrid) {
+        multigrid.reset (new Multigrid ());
+        multigrid->build (vertices, triangles);
+    }
+    if (progress)
+        progress->set ("Calcul des poids", 0.f);
+    x.resize (rhs.rows (), rhs.cols ());
+    for (int j = 0; j < rhs.cols (); j++) {
+        Eigen::VectorXf guess;
+        warmStart (rhs, j, guess);
+        x.col (j) = guess;
+    }
+    bool converged = multigrid->solve (A, rhs, x, tolerance, maxIterations != 0 ? maxIterations : 100, progress);
+    lastIterations = multigrid->getLastCycles ();
+    previous = x;
+    return converged;
+}
+
+bool WeightSolver::solveIterative (const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress) {
+    //pas de factorisation gardée en mode itératif : c'est justement elle qu'on veut éviter
+    solver.reset ();
+    multigrid.reset ();
+    if (preconditioner == INCOMPLETE_CHOLESKY) {
+        Eigen::ConjugateGradient< Eigen::SparseMatrix<float>, Eigen::Lower | Eigen::Upper, Eigen::IncompleteCholesky<float> > cg;
+        return runConjugateGradient (cg, rhs, x, progress);
+    }
+    Eigen::ConjugateGradient< Eigen::SparseMatrix<float>, Eigen::Lower | Eigen::Upper, Eigen::DiagonalPreconditioner<float> > cg;
+    return runConjugateGradient (cg, rhs, x, progress);
+}
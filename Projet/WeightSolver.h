@@ -0,0 +1,102 @@
+//
+//  WeightSolver.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 28/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__WeightSolver__
+#define __Projet__WeightSolver__
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "Vertex.h"
+#include "Triangle.h"
+
+class Multigrid;
+class Progress;
+
+class WeightSolver {
+    //résolution du système des poids (cf article 2007 Baran and Popovic) : (-L + H) W = H P,
+    //une colonne par bone. La Laplacienne L (cf Laplacian) ne dépend que du mesh : elle est gardée avec
+    //l'analyse symbolique de -L + H tant que les vertices et les triangles ne changent pas. Quand seul le
+    //squelette bouge (H change), on ne refait que la factorisation numérique.
+    //pour les très gros meshes, la factorisation LDLT est le pic mémoire de l'application : au-delà de
+    //MULTIGRID_THRESHOLD vertices (mode AUTO), on passe à la multigrille (cf Multigrid). Le gradient conjugué
+    //préconditionné reste disponible. Les deux repartent des poids de la résolution précédente.
+    //une copie garde les réglages mais pas les calculs (elle recalculera L au premier appel).
+public:
+    typedef Eigen::SimplicialLDLT< Eigen::SparseMatrix<float> > Solver;
+
+    enum Mode { AUTO = 0, DIRECT, ITERATIVE, MULTIGRID };
+    enum Preconditioner { JACOBI = 0, INCOMPLETE_CHOLESKY };
+
+    static const unsigned int MULTIGRID_THRESHOLD = 200000;
+    static const float DEFAULT_TOLERANCE;
+
+    WeightSolver ();
+    WeightSolver (const WeightSolver &);
+    ~WeightSolver ();
+    WeightSolver & operator= (const WeightSolver &);
+    void swap (WeightSolver & solver);
+    void clear ();
+
+    inline void setMode (Mode m) { mode = m; }
+    inline Mode getMode () const { return mode; }
+    inline void setPreconditioner (Preconditioner p) { preconditioner = p; }
+    inline Preconditioner getPreconditioner () const { return preconditioner; }
+    //erreur relative |A x - b| / |b| visée par le gradient conjugué et la multigrille
+    inline void setTolerance (float t) { tolerance = t; }
+    inline float getTolerance () const { return tolerance; }
+    inline void setMaxIterations (unsigned int n) { maxIterations = n; }
+    inline unsigned int getMaxIterations () const { return maxIterations; }
+    //mode réellement utilisé pour un mesh de nbVertices vertices
+    Mode effectiveMode (unsigned int nbVertices) const;
+
+    //h : diagonale de H, rhs : H P. Renvoie false si la factorisation échoue.
+    //progress (optionnel) est consulté entre la factorisation et la résolution, à chaque colonne du gradient
+    //conjugué et à chaque itération de la multigrille (Progress::Cancelled interrompt la résolution)
+    bool solve (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                const Eigen::VectorXf & h, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress = NULL);
+
+    //L et l'analyse symbolique sont à jour pour ce mesh
+    bool isPrepared (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles) const;
+    inline const Eigen::SparseMatrix<float> & getLaplacian () const { return L; }
+    //itérations du dernier gradient conjugué (max sur les bones) ou itérations préconditionnées par la multigrille, 0 en mode direct
+    inline unsigned int getLastIterations () const { return lastIterations; }
+
+    static uint64_t geometryKey (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles);
+
+private:
+    void prepare (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles);
+    bool solveDirect (const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress);
+    bool solveIterative (const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress);
+    bool solveMultigrid (const std::vector<Vertex> & vertices, const std::vector<Triangle> & triangles,
+                         const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress);
+    void warmStart (const Eigen::MatrixXf & rhs, unsigned int column, Eigen::VectorXf & guess) const;
+    template <class CG> bool runConjugateGradient (CG & cg, const Eigen::MatrixXf & rhs, Eigen::MatrixXf & x, Progress * progress);
+
+    Mode mode;
+    Preconditioner preconditioner;
+    float tolerance;
+    unsigned int maxIterations;
+
+    bool prepared;
+    uint64_t key;
+    unsigned int nbVertices;
+    Eigen::SparseMatrix<float> L;
+    Eigen::SparseMatrix<float> A;               // -L + H, motif fixe (diagonale toujours présente)
+    Eigen::VectorXf minusLDiagonal;
+    std::vector<int> diagonalIndex;             // position de A(i,i) dans A.valuePtr()
+    std::unique_ptr<Solver> solver;             // mode direct : analyzePattern fait une fois pour A
+    std::unique_ptr<Multigrid> multigrid;       // mode multigrille : hiérarchie du mesh
+    Eigen::MatrixXf previous;                   // modes itératifs : dernière solution, point de départ suivant
+    unsigned int lastIterations;
+};
+
+#endif /* defined(__Projet__WeightSolver__) */
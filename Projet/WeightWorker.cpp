@@ -0,0 +1,104 @@
+//
+//  WeightWorker.cpp
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#include "WeightWorker.h"
+
+#include <thread>
+
+using namespace std;
+
+WeightWorker::WeightWorker () : solver (make_shared<Solver> ()) {}
+
+void WeightWorker::run (shared_ptr<Job> job) {
+    //le calcul précédent (annulé) libère d'abord le mesh de travail
+    lock_guard<mutex> lock (job->solver->mutex);
+    Mesh & mesh = job->solver->mesh;
+    try {
+        job->progress.set ("Calcul des poids", 0.f);
+        //mêmes vertices et triangles que le calcul précédent : le WeightSolver garde L et son analyse
+        mesh.getVertices ().swap (job->vertices);
+        mesh.getTriangles ().swap (job->triangles);
+        mesh.getBonesVertices ().swap (job->vertices_bones);
+        mesh.getBones ().swap (job->bones);
+        WeightSolver & weightSolver = mesh.getWeightSolver ();
+        weightSolver.setMode (job->settings.getMode ());
+        weightSolver.setPreconditioner (job->settings.getPreconditioner ());
+        weightSolver.setTolerance (job->settings.getTolerance ());
+        weightSolver.setMaxIterations (job->settings.getMaxIterations ());
+        mesh.getInfluences ().setPrecision (job->influences.getPrecision ());
+
+        mesh.initWeights (&job->progress);
+        mesh.getInfluences ().swap (job->influences);
+        //si l'interface a annulé entre temps, le résultat ne sera jamais récupéré
+        int expected = Running;
+        job->state.compare_exchange_strong (expected, int (Finished));
+    } catch (const Progress::Cancelled &) {
+        job->state = Cancelled;
+    }
+    //les bones du mesh de travail sont les copies du calcul
+    vector<Armature *> & bones = mesh.getBones ();
+    for (unsigned int i = 0; i < bones.size (); i++)
+        delete bones[i];
+    bones.clear ();
+    for (unsigned int i = 0; i < job->bones.size (); i++)
+        delete job->bones[i];
+    job->bones.clear ();
+}
+
+void WeightWorker::start (const Mesh & mesh) {
+    cancel ();
+    job = make_shared<Job> ();
+    job->solver = solver;
+    job->vertices = mesh.getVertices ();
+    job->triangles = mesh.getTriangles ();
+    job->vertices_bones = mesh.getBonesVertices ();
+    job->bones.reserve (mesh.getBones ().size ());
+    for (unsigned int i = 0; i < mesh.getBones ().size (); i++)
+        job->bones.push_back (mesh.getBones ()[i]->clone ());
+    job->skeletonStamp = mesh.getSkeletonStamp ();
+    job->settings = mesh.getWeightSolver ();
+    job->influences.setPrecision (mesh.getInfluences ().getPrecision ());
+    thread worker (run, job);
+    worker.detach ();
+}
+
+void WeightWorker::cancel () {
+    if (!job)
+        return;
+    job->progress.cancel ();
+    int expected = Running;
+    job->state.compare_exchange_strong (expected, int (Cancelled));
+    job.reset ();
+}
+
+WeightWorker::State WeightWorker::getState () const {
+    if (!job)
+        return Idle;
+    return State (int (job->state));
+}
+
+void WeightWorker::getProgress (string & step, float & fraction) const {
+    step.clear ();
+    fraction = 0.f;
+    if (job)
+        job->progress.get (step, fraction);
+}
+
+bool WeightWorker::takeResult (Mesh & mesh) {
+    if (getState () != Finished)
+        return false;
+    //échange en O(1) : le thread a fini d'écrire dans job->influences. Le nombre de bones ne suffit pas :
+    //un bone supprimé puis un autre ajouté donnent une table de la bonne taille, pour d'autres bones
+    bool valid = job->skeletonStamp == mesh.getSkeletonStamp ()
+        && job->influences.getNbVertices () == mesh.getVertices ().size ()
+        && job->influences.getNbBones () == mesh.getBones ().size ();
+    if (valid)
+        mesh.swapInfluences (job->influences);
+    job.reset ();
+    return valid;
+}
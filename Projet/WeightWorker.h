@@ -0,0 +1,72 @@
+//
+//  WeightWorker.h
+//  Projet
+//
+//  Created by Audrey FOURNERET on 30/06/14.
+//  Copyright (c) 2014 Audrey FOURNERET. All rights reserved.
+//
+
+#ifndef __Projet__WeightWorker__
+#define __Projet__WeightWorker__
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+#include "Mesh.h"
+#include "Progress.h"
+
+class WeightWorker {
+    //calcul des poids dans un thread à part, sans Qt (même fonctionnement que MeshLoader).
+    //start() recopie le mesh et le squelette puis lance la résolution ; la table des influences est écrite
+    //dans un tampon propre au calcul, échangé avec celle du mesh par takeResult (depuis l'interface,
+    //entre deux affichages). Une nouvelle modification annule le calcul en cours : il s'arrête au prochain
+    //point d'arrêt (cf Progress) et son résultat n'est jamais installé.
+    //les calculs passent l'un après l'autre sur le même mesh de travail : son WeightSolver garde L et
+    //l'analyse symbolique d'un calcul à l'autre (seul le squelette change pendant l'édition).
+public:
+    typedef enum {Idle=0, Running=1, Finished=2, Cancelled=3} State;
+
+    WeightWorker ();
+    virtual ~WeightWorker () { cancel (); }
+
+    //annule le calcul en cours s'il y en a un
+    void start (const Mesh & mesh);
+    void cancel ();
+
+    State getState () const;
+    void getProgress (std::string & step, float & fraction) const;
+
+    //échange la table calculée avec celle de mesh (état Finished) ; false si le squelette de mesh a été modifié
+    //depuis start (cf Mesh::getSkeletonStamp) ou si le mesh n'a plus le nombre de vertices ou de bones du calcul
+    bool takeResult (Mesh & mesh);
+
+private:
+    //mesh de travail partagé par les calculs successifs (un seul à la fois)
+    struct Solver {
+        std::mutex mutex;
+        Mesh mesh;
+    };
+
+    struct Job {
+        Job () : skeletonStamp (0), state (Running) {}
+        std::shared_ptr<Solver> solver;
+        std::vector<Vertex> vertices;
+        std::vector<Triangle> triangles;
+        std::vector<Vertex> vertices_bones;
+        std::vector<Armature *> bones;      // copies, libérées par le thread
+        unsigned int skeletonStamp;         // version du squelette recopié
+        WeightSolver settings;              // réglages du mesh de l'interface (mode, tolérance...)
+        Progress progress;
+        std::atomic<int> state;
+        InfluenceTable influences;          // tampon arrière
+    };
+
+    static void run (std::shared_ptr<Job> job);
+
+    std::shared_ptr<Solver> solver;
+    std::shared_ptr<Job> job;
+};
+
+#endif /* defined(__Projet__WeightWorker__) */
@@ -36,8 +36,12 @@
 
 using namespace std;
 
+//fenêtre principale, pour showStatusMessage
+static Window * mainWindow = NULL;
+
 
 Window::Window () : QMainWindow (NULL) {
+    mainWindow = this;
     try {
         viewer = new GLViewer;
     } catch (GLViewer::Exception e) {
@@ -62,7 +66,14 @@ Window::Window () : QMainWindow (NULL) {
 }
 
 Window::~Window () {
+    if (mainWindow == this)
+        mainWindow = NULL;
+
+}
 
+void Window::showStatusMessage (const QString & msg) {
+    if (mainWindow != NULL)
+        mainWindow->statusBar()->showMessage (msg);
 }
 
 void Window::setBGColor () {
@@ -112,6 +123,10 @@ void Window::initControlWidget () {
     connect (snapshotButton, SIGNAL (clicked ()) , viewer, SLOT (loadMesh ()));
     previewLayout->addWidget (snapshotButton);
     
+    QPushButton * cancelLoadButton = new QPushButton ("Cancel loading", previewGroupBox);
+    connect (cancelLoadButton, SIGNAL (clicked ()), viewer, SLOT (cancelLoading ()));
+    previewLayout->addWidget (cancelLoadButton);
+    
     QPushButton * saveMeshButton = new QPushButton ("Save mesh and bones", previewGroupBox);
     connect (saveMeshButton, SIGNAL(clicked()), viewer, SLOT (exportMesh() ) );
     previewLayout->addWidget(saveMeshButton);
@@ -147,6 +162,17 @@ void Window::initControlWidget () {
     globalLayout->addWidget(selectMode);
     globalLayout->addWidget(box);
     
+    QButtonGroup * skinningGroup = new QButtonGroup (globalGroupBox);
+    skinningGroup->setExclusive (true);
+    QRadioButton * linearButton = new QRadioButton ("Linear blend skinning", globalGroupBox);
+    QRadioButton * dualQuaternionButton = new QRadioButton ("Dual quaternion skinning", globalGroupBox);
+    skinningGroup->addButton (linearButton, static_cast<int>(Skinning::LINEAR));
+    skinningGroup->addButton (dualQuaternionButton, static_cast<int>(Skinning::DUAL_QUATERNION));
+    connect (skinningGroup, SIGNAL (buttonClicked (int)), viewer, SLOT (setSkinningMode (int)));
+    linearButton->setChecked (true);
+    globalLayout->addWidget (linearButton);
+    globalLayout->addWidget (dualQuaternionButton);
+    
     
     QPushButton * bgColorButton  = new QPushButton ("Background Color", globalGroupBox);
     connect (bgColorButton, SIGNAL (clicked()) , this, SLOT (setBGColor()));